@@ -0,0 +1,218 @@
+#include "analytics.h"
+#include "../metrics/metrics.h"
+
+#if !defined(YADA_NO_SIMD) && (defined(__x86_64__) || defined(__i386__))
+#define YADA_AVX2 1
+#include <immintrin.h>
+#endif
+
+static bool useAvx2() {
+#ifdef YADA_AVX2
+    static const bool supported = __builtin_cpu_supports("avx2");
+    return supported;
+#else
+    return false;
+#endif
+}
+
+static long sumScalar(const int32_t* values, size_t count) {
+    long total = 0;
+    for (size_t i = 0; i < count; ++i) {
+        total += values[i];
+    }
+    return total;
+}
+
+static void minMaxScalar(const int32_t* values, size_t count, int32_t& minimum, int32_t& maximum) {
+    for (size_t i = 0; i < count; ++i) {
+        minimum = min(minimum, values[i]);
+        maximum = max(maximum, values[i]);
+    }
+}
+
+// First row from row on whose key is at least limit
+static size_t runEndScalar(const int32_t* keys, size_t row, size_t count, int32_t limit) {
+    while (row < count && keys[row] < limit) ++row;
+    return row;
+}
+
+#ifdef YADA_AVX2
+// Compiled for AVX2 whatever the build flags say; only called once the CPU
+// is known to have it
+__attribute__((target("avx2"))) static long sumAvx2(const int32_t* values, size_t count) {
+    // Widened to 64-bit lanes so long histories cannot overflow
+    __m256i low = _mm256_setzero_si256();
+    __m256i high = _mm256_setzero_si256();
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(values + i));
+        low = _mm256_add_epi64(low, _mm256_cvtepi32_epi64(_mm256_castsi256_si128(block)));
+        high = _mm256_add_epi64(high, _mm256_cvtepi32_epi64(_mm256_extracti128_si256(block, 1)));
+    }
+    int64_t lanes[4];
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(lanes), _mm256_add_epi64(low, high));
+    return lanes[0] + lanes[1] + lanes[2] + lanes[3] + sumScalar(values + i, count - i);
+}
+
+__attribute__((target("avx2"))) static void minMaxAvx2(const int32_t* values, size_t count, int32_t& minimum,
+                                                       int32_t& maximum) {
+    size_t i = 0;
+    if (count >= 8) {
+        __m256i low = _mm256_set1_epi32(minimum);
+        __m256i high = _mm256_set1_epi32(maximum);
+        for (; i + 8 <= count; i += 8) {
+            __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(values + i));
+            low = _mm256_min_epi32(low, block);
+            high = _mm256_max_epi32(high, block);
+        }
+        int32_t lows[8], highs[8];
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(lows), low);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(highs), high);
+        minimum = *min_element(lows, lows + 8);
+        maximum = *max_element(highs, highs + 8);
+    }
+    minMaxScalar(values + i, count - i, minimum, maximum);
+}
+
+__attribute__((target("avx2"))) static size_t runEndAvx2(const int32_t* keys, size_t row, size_t count,
+                                                         int32_t limit) {
+    // Keys are sorted, so the lanes below limit are always a prefix
+    __m256i bound = _mm256_set1_epi32(limit);
+    for (; row + 8 <= count; row += 8) {
+        __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(keys + row));
+        unsigned below = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(bound, block)));
+        if (below != 0xff) return row + __builtin_ctz(~below);
+    }
+    return runEndScalar(keys, row, count, limit);
+}
+#endif
+
+long sumColumn(const int32_t* values, size_t count) {
+#ifdef YADA_AVX2
+    if (useAvx2()) return sumAvx2(values, count);
+#endif
+    return sumScalar(values, count);
+}
+
+void minMaxColumn(const int32_t* values, size_t count, int32_t& minimum, int32_t& maximum) {
+    minimum = numeric_limits<int32_t>::max();
+    maximum = numeric_limits<int32_t>::min();
+#ifdef YADA_AVX2
+    if (useAvx2()) {
+        minMaxAvx2(values, count, minimum, maximum);
+        return;
+    }
+#endif
+    minMaxScalar(values, count, minimum, maximum);
+}
+
+void sumSortedGroups(const int32_t* keys, const int32_t* values, size_t count, int32_t firstKey,
+                     vector<GroupTotal>& groups) {
+    bool vectorized = useAvx2();
+    size_t row = 0;
+    while (row < count) {
+        int32_t key = keys[row];
+        size_t end = row + 1;
+#ifdef YADA_AVX2
+        if (vectorized) end = runEndAvx2(keys, end, count, key + 1);
+#endif
+        if (!vectorized) end = runEndScalar(keys, end, count, key + 1);
+        GroupTotal& group = groups[key - firstKey];
+        group.calories += sumColumn(values + row, end - row);
+        group.entries += end - row;
+        row = end;
+    }
+}
+
+void sumByKey(const uint32_t* keys, const int32_t* values, size_t count, vector<GroupTotal>& groups) {
+    for (size_t i = 0; i < count; ++i) {
+        GroupTotal& group = groups[keys[i]];
+        group.calories += values[i];
+        ++group.entries;
+    }
+}
+
+const char* columnKernel() {
+    return useAvx2() ? "avx2" : "scalar";
+}
+
+string dayName(int day) {
+    // Civil date of a day count since 1970-01-01, the inverse of localDay
+    int z = day + 719468;
+    int era = (z >= 0 ? z : z - 146096) / 146097;
+    int doe = z - era * 146097;
+    int yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    int doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    int mp = (5 * doy + 2) / 153;
+    int d = doy - (153 * mp + 2) / 5 + 1;
+    int m = mp < 10 ? mp + 3 : mp - 9;
+    int y = yoe + era * 400 + (m <= 2);
+    char buffer[32];
+    snprintf(buffer, sizeof(buffer), "%04d-%02d-%02d", y, m, d);
+    return buffer;
+}
+
+CalorieReport buildCalorieReport(LogManager& log, time_t from, time_t to, size_t topFoodCount) {
+    YADA_TIMED("log_group_report");
+    CalorieReport report;
+    report.firstDay = LogManager::localDay(from);
+    report.lastDay = LogManager::localDay(to);
+    if (report.lastDay < report.firstDay) {
+        return report;
+    }
+    int dayCount = report.lastDay - report.firstDay + 1;
+    report.days.resize(dayCount);
+
+    // Food names in range get dense slots, so grouping costs the rows
+    // scanned rather than the size of the symbol table
+    unordered_map<Symbol, uint32_t> slots;
+    vector<Symbol> names;
+    vector<GroupTotal> foods;
+    vector<uint32_t> keys;
+    int32_t smallest = numeric_limits<int32_t>::max();
+    int32_t largest = numeric_limits<int32_t>::min();
+    log.scanEntries(from, to, [&](const LogColumns& rows, size_t first, size_t last) {
+        size_t count = last - first;
+        const int32_t* days = rows.dayColumn() + first;
+        const int32_t* calories = rows.calorieColumn() + first;
+        report.calories += sumColumn(calories, count);
+        report.entries += count;
+        int32_t low, high;
+        minMaxColumn(calories, count, low, high);
+        smallest = min(smallest, low);
+        largest = max(largest, high);
+        sumSortedGroups(days, calories, count, report.firstDay, report.days);
+        const Symbol* rowNames = rows.nameColumn() + first;
+        keys.resize(count);
+        for (size_t i = 0; i < count; ++i) {
+            auto slot = slots.try_emplace(rowNames[i], names.size()).first;
+            if (slot->second == names.size()) names.push_back(rowNames[i]);
+            keys[i] = slot->second;
+        }
+        foods.resize(names.size());
+        sumByKey(keys.data(), calories, count, foods);
+    });
+    if (report.entries > 0) {
+        report.smallestEntry = smallest;
+        report.largestEntry = largest;
+    }
+
+    report.weeks.resize((dayCount + 6) / 7);
+    for (int day = 0; day < dayCount; ++day) {
+        report.weeks[day / 7].calories += report.days[day].calories;
+        report.weeks[day / 7].entries += report.days[day].entries;
+    }
+
+    report.topFoods.reserve(names.size());
+    for (size_t slot = 0; slot < names.size(); ++slot) {
+        report.topFoods.emplace_back(names[slot], foods[slot]);
+    }
+    auto higher = [](const pair<Symbol, GroupTotal>& a, const pair<Symbol, GroupTotal>& b) {
+        return a.second.calories != b.second.calories ? a.second.calories > b.second.calories
+                                                       : symbols().text(a.first) < symbols().text(b.first);
+    };
+    size_t kept = min(topFoodCount, report.topFoods.size());
+    partial_sort(report.topFoods.begin(), report.topFoods.begin() + kept, report.topFoods.end(), higher);
+    report.topFoods.resize(kept);
+    return report;
+}
@@ -0,0 +1,52 @@
+#ifndef ANALYTICS_H
+#define ANALYTICS_H
+
+#include <bits/stdc++.h>
+#include "../log/log.h"
+using namespace std;
+
+// Calories and entry count of one group of log entries
+struct GroupTotal {
+    long calories = 0;
+    int entries = 0;
+};
+
+// Calories of the entries logged from firstDay to lastDay (local days, see
+// LogManager::localDay), in all and grouped by day, by week and by food
+struct CalorieReport {
+    int firstDay = 0;
+    int lastDay = -1;
+    long calories = 0;
+    int entries = 0;
+    // Calories of the smallest and largest single entry; zero without entries
+    int smallestEntry = 0;
+    int largestEntry = 0;
+    vector<GroupTotal> days;
+    // Seven days each, the first starting on firstDay
+    vector<GroupTotal> weeks;
+    // The foods with the most calories, most first
+    vector<pair<Symbol, GroupTotal>> topFoods;
+};
+
+// Builds the report from the log's day, calorie and food name columns,
+// loading the months the range covers
+CalorieReport buildCalorieReport(LogManager& log, time_t from, time_t to, size_t topFoodCount = 10);
+// "YYYY-MM-DD" of a local day number
+string dayName(int day);
+
+// Column kernels. They run on AVX2 when the CPU has it and as plain loops
+// otherwise, or always when built with -DYADA_NO_SIMD.
+long sumColumn(const int32_t* values, size_t count);
+void minMaxColumn(const int32_t* values, size_t count, int32_t& minimum, int32_t& maximum);
+// Adds each value to groups[key - firstKey]. Keys must be sorted, so every
+// group is one run: its end is found eight keys at a time and its values
+// summed with sumColumn.
+void sumSortedGroups(const int32_t* keys, const int32_t* values, size_t count, int32_t firstKey,
+                     vector<GroupTotal>& groups);
+// Adds each value to groups[key], for keys in any order. Always scalar:
+// AVX2 has gathers but no scatter stores.
+void sumByKey(const uint32_t* keys, const int32_t* values, size_t count, vector<GroupTotal>& groups);
+// "avx2" or "scalar", whichever the kernels use
+const char* columnKernel();
+
+#endif // ANALYTICS_H
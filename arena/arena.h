@@ -0,0 +1,88 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <bits/stdc++.h>
+using namespace std;
+
+// Read-only run of T held in an Arena. It is as cheap to copy as a pointer
+// and stays valid for as long as the arena it came from.
+template <typename T>
+class ArenaSpan {
+public:
+    ArenaSpan() = default;
+    ArenaSpan(const T* items, uint32_t count) : items(items), count(count) {}
+
+    const T* begin() const { return items; }
+    const T* end() const { return items + count; }
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    const T& operator[](size_t i) const { return items[i]; }
+
+private:
+    const T* items = nullptr;
+    uint32_t count = 0;
+};
+
+// Monotonic allocator: hands out memory by bumping a pointer through large
+// blocks and frees nothing until the arena itself goes, all in one step.
+// Suited to data that lives as long as its owner, such as food keyword lists
+// and interned names; a replaced list simply stays behind until then. Not
+// thread-safe, so callers serialize allocation.
+class Arena {
+public:
+    explicit Arena(size_t blockSize = 1 << 20) : blockSize(blockSize) {}
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    void* allocate(size_t bytes, size_t alignment) {
+        uintptr_t address = (reinterpret_cast<uintptr_t>(cursor) + alignment - 1) & ~(alignment - 1);
+        if (!cursor || address + bytes > reinterpret_cast<uintptr_t>(limit)) {
+            // Anything larger than a quarter block gets a block of its own,
+            // so the current block is not abandoned half full
+            size_t size = bytes + alignment;
+            if (size > blockSize / 4) {
+                blocks.emplace_back(new char[size]);
+                return align(blocks.back().get(), alignment);
+            }
+            blocks.emplace_back(new char[blockSize]);
+            cursor = blocks.back().get();
+            limit = cursor + blockSize;
+            address = reinterpret_cast<uintptr_t>(align(cursor, alignment));
+        }
+        cursor = reinterpret_cast<char*>(address + bytes);
+        return reinterpret_cast<void*>(address);
+    }
+
+    template <typename T>
+    ArenaSpan<T> copy(const T* items, size_t count) {
+        static_assert(is_trivially_copyable_v<T>, "arena storage is never destroyed");
+        if (count == 0) return ArenaSpan<T>();
+        T* stored = static_cast<T*>(allocate(count * sizeof(T), alignof(T)));
+        memcpy(stored, items, count * sizeof(T));
+        return ArenaSpan<T>(stored, count);
+    }
+
+    template <typename T>
+    ArenaSpan<T> copy(const vector<T>& items) {
+        return copy(items.data(), items.size());
+    }
+
+    string_view copy(string_view text) {
+        if (text.empty()) return string_view();
+        char* stored = static_cast<char*>(allocate(text.size(), 1));
+        memcpy(stored, text.data(), text.size());
+        return string_view(stored, text.size());
+    }
+
+private:
+    size_t blockSize;
+    vector<unique_ptr<char[]>> blocks;
+    char* cursor = nullptr;
+    char* limit = nullptr;
+
+    static void* align(char* address, size_t alignment) {
+        return reinterpret_cast<void*>((reinterpret_cast<uintptr_t>(address) + alignment - 1) & ~(alignment - 1));
+    }
+};
+
+#endif // ARENA_H
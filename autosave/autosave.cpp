@@ -0,0 +1,53 @@
+#include "autosave.h"
+#include "../metrics/metrics.h"
+
+AutoSaver::~AutoSaver() {
+    stop();
+}
+
+void AutoSaver::watch(function<void()> save) {
+    saves.push_back(move(save));
+}
+
+void AutoSaver::start() {
+    worker = thread([this] { run(); });
+}
+
+void AutoSaver::notify() {
+    lock_guard<mutex> guard(lock);
+    if (!pending) {
+        pending = true;
+        wake.notify_one();
+    }
+}
+
+void AutoSaver::stop() {
+    {
+        lock_guard<mutex> guard(lock);
+        stopping = true;
+    }
+    wake.notify_one();
+    if (worker.joinable()) {
+        worker.join();
+    }
+}
+
+void AutoSaver::run() {
+    unique_lock<mutex> guard(lock);
+    while (true) {
+        wake.wait(guard, [this] { return pending || stopping; });
+        if (!pending) return;
+
+        // Changes made before the deadline ride along with the first one
+        wake.wait_until(guard, chrono::steady_clock::now() + latency, [this] { return stopping; });
+        pending = false;
+        guard.unlock();
+        {
+            YADA_TIMED("autosave");
+            for (auto& save : saves) {
+                save();
+            }
+        }
+        guard.lock();
+    }
+}
@@ -0,0 +1,35 @@
+#ifndef AUTOSAVE_H
+#define AUTOSAVE_H
+
+#include <bits/stdc++.h>
+using namespace std;
+
+// Background persistence thread. Stores call notify() when they change;
+// the worker then waits out the latency bound, so a burst of changes is
+// written once, and runs every registered save. Each save skips whatever
+// it has not changed since its last write.
+class AutoSaver {
+public:
+    explicit AutoSaver(chrono::milliseconds latency) : latency(latency) {}
+    AutoSaver(const AutoSaver&) = delete;
+    AutoSaver& operator=(const AutoSaver&) = delete;
+    ~AutoSaver();
+
+    void watch(function<void()> save);
+    void start();
+    void notify();
+    // Runs a last pass for pending changes, then joins the worker
+    void stop();
+
+private:
+    chrono::milliseconds latency;
+    vector<function<void()>> saves;
+    thread worker;
+    mutex lock;
+    condition_variable wake;
+    bool pending = false;
+    bool stopping = false;
+    void run();
+};
+
+#endif // AUTOSAVE_H
@@ -0,0 +1,291 @@
+#include "batch.h"
+#include "../metrics/metrics.h"
+#include "../io/lines.h"
+#include "../analytics/analytics.h"
+
+static vector<string_view> splitWords(string_view line) {
+    vector<string_view> words;
+    size_t pos = 0;
+    while (pos < line.size()) {
+        while (pos < line.size() && isspace(static_cast<unsigned char>(line[pos]))) ++pos;
+        size_t start = pos;
+        while (pos < line.size() && !isspace(static_cast<unsigned char>(line[pos]))) ++pos;
+        if (pos > start) {
+            words.push_back(line.substr(start, pos - start));
+        }
+    }
+    return words;
+}
+
+// Accepts YYYY-MM-DD (local midnight) or raw epoch seconds, within the
+// range LogManager accepts
+static bool parseDate(string_view text, time_t& date) {
+    long long seconds;
+    if (text.find('-') == string_view::npos) {
+        if (!parseNumber(text, seconds)) return false;
+        date = seconds;
+        return date >= LogManager::earliestDate && date <= LogManager::latestDate;
+    }
+
+    tm tm = {};
+    istringstream iss{string(text)};
+    iss >> get_time(&tm, "%Y-%m-%d");
+    if (iss.fail() || iss.peek() != char_traits<char>::eof()) return false;
+    tm.tm_isdst = -1;
+    date = mktime(&tm);
+    return date != -1 && date >= LogManager::earliestDate && date <= LogManager::latestDate;
+}
+
+BatchRunner::BatchRunner(FoodList& foodList, LogManager& logManager, DietProfile& profile)
+    : foodList(foodList), logManager(logManager), profile(profile) {}
+
+bool BatchRunner::execute(string_view line, ostream& out, string& error) {
+    vector<string_view> args = splitWords(line);
+    if (args.empty() || args[0][0] == '#') {
+        return true;
+    }
+    ++commands;
+
+    string_view command = args[0];
+    if (command == "add-food") {
+        int calories;
+        if (args.size() < 3 || !parseNumber(args[2], calories)) {
+            error = "usage: add-food <name> <calories> [keyword ...]";
+            return false;
+        }
+        if (foodList.addBasicFood(args[1], vector<string>(args.begin() + 3, args.end()), calories) == noFood) {
+            error = "food " + string(args[1]) + " already exists";
+            return false;
+        }
+        return true;
+    }
+
+    if (command == "add-composite") {
+        auto bar = find(args.begin(), args.end(), "|");
+        if (args.size() < 2 || bar == args.end() || bar < args.begin() + 2) {
+            error = "usage: add-composite <name> [keyword ...] | <food>:<servings> ...";
+            return false;
+        }
+
+        vector<Ingredient> ingredients;
+        for (auto it = bar + 1; it != args.end(); ++it) {
+            size_t colon = it->rfind(':');
+            double quantity = 0;
+            FoodId food = colon == string_view::npos ? noFood : foodList.findByName(it->substr(0, colon));
+            if (food == noFood || !parseNumber(it->substr(colon + 1), quantity) || quantity <= 0) {
+                error = "invalid ingredient " + string(*it);
+                return false;
+            }
+            ingredients.push_back({food, quantity});
+        }
+        if (foodList.addCompositeFood(args[1], vector<string>(args.begin() + 2, bar), ingredients) == noFood) {
+            error = "food " + string(args[1]) + " already exists";
+            return false;
+        }
+        return true;
+    }
+
+    if (command == "log") {
+        int servings;
+        time_t date;
+        // Any date given is kept, epoch 0 included
+        bool dated = args.size() == 4;
+        if (args.size() < 3 || args.size() > 4 || !parseNumber(args[2], servings) ||
+            (dated && !parseDate(args[3], date))) {
+            error = "usage: log <food> <servings> [YYYY-MM-DD | epoch-seconds]";
+            return false;
+        }
+        if (servings <= 0) {
+            error = "servings must be positive";
+            return false;
+        }
+        if (!dated) {
+            date = time(nullptr);
+        }
+
+        FoodId id = foodList.findByName(args[1]);
+        if (id == noFood) {
+            error = "unknown food " + string(args[1]);
+            return false;
+        }
+        const Food& food = foodList.getFoods()[id];
+        logManager.addEntry(id, food.name, servings, food.calories, date);
+        return true;
+    }
+
+    if (command == "delete") {
+        int number;
+        if (args.size() != 2 || !parseNumber(args[1], number)) {
+            error = "usage: delete <entry-number>";
+            return false;
+        }
+        if (!logManager.deleteEntry(number - 1)) {
+            error = "no log entry " + string(args[1]);
+            return false;
+        }
+        return true;
+    }
+
+    if (command == "undo" || command == "redo") {
+        bool done = command == "undo" ? logManager.undo() : logManager.redo();
+        if (!done) {
+            error = "nothing to " + string(command);
+            return false;
+        }
+        return true;
+    }
+
+    if (command == "search") {
+        if (args.size() < 3 || (args[1] != "any" && args[1] != "all")) {
+            error = "usage: search any|all <keyword ...>";
+            return false;
+        }
+        foodList.forEachMatch(vector<string>(args.begin() + 2, args.end()), args[1] == "all", 0,
+                              numeric_limits<size_t>::max(), [&](FoodId, const Food& food) {
+                                  out << food.nameText() << ' ' << food.calories << '\n';
+                              });
+        return true;
+    }
+
+    if (command == "find") {
+        if (args.size() < 2) {
+            error = "usage: find <word ...>";
+            return false;
+        }
+        size_t start = args[1].data() - line.data();
+        for (const auto& match : foodList.searchFoods(line.substr(start), 10)) {
+            const Food& food = foodList.getFoods()[match.food];
+            out << food.nameText() << ' ' << food.calories << '\n';
+        }
+        return true;
+    }
+
+    if (command == "summary") {
+        time_t date = time(nullptr);
+        int method = 1;
+        if (args.size() > 3 || (args.size() >= 2 && !parseDate(args[1], date)) ||
+            (args.size() == 3 && (!parseNumber(args[2], method) || method < 1 || method > 3))) {
+            error = "usage: summary [YYYY-MM-DD] [method]";
+            return false;
+        }
+
+        int totalCalories = logManager.getTotalCalories(date);
+        int targetCalories = profile.calculateTargetCalories(static_cast<Equation>(method - 1));
+        char buffer[80];
+        tm local;
+        strftime(buffer, sizeof(buffer), "%Y-%m-%d", localtime_r(&date, &local));
+        out << buffer << " consumed " << totalCalories << " target " << targetCalories
+            << " difference " << totalCalories - targetCalories << '\n';
+        return true;
+    }
+
+    if (command == "target") {
+        int method = 1;
+        if (args.size() > 2 || (args.size() == 2 && (!parseNumber(args[1], method) || method < 1 || method > 3))) {
+            error = "usage: target [method]";
+            return false;
+        }
+        out << "target " << profile.calculateTargetCalories(static_cast<Equation>(method - 1)) << '\n';
+        return true;
+    }
+
+    if (command == "report") {
+        time_t from, to;
+        if (args.size() != 3 || !parseDate(args[1], from) || !parseDate(args[2], to)) {
+            error = "usage: report <from YYYY-MM-DD> <to YYYY-MM-DD>";
+            return false;
+        }
+        out << "total " << logManager.getTotalCalories(from, to) << " logged-days "
+            << logManager.getLoggedDays(from, to) << " average " << lround(logManager.getAverageCalories(from, to))
+            << '\n';
+        return true;
+    }
+
+    if (command == "report-by") {
+        time_t from, to;
+        int count = 10;
+        if (args.size() < 4 || args.size() > 5 || (args[1] != "day" && args[1] != "week" && args[1] != "food") ||
+            !parseDate(args[2], from) || !parseDate(args[3], to) ||
+            (args.size() == 5 && (!parseNumber(args[4], count) || count < 1))) {
+            error = "usage: report-by day|week|food <from YYYY-MM-DD> <to YYYY-MM-DD> [top-count]";
+            return false;
+        }
+        CalorieReport report = buildCalorieReport(logManager, from, to, count);
+        if (args[1] == "food") {
+            for (const auto& food : report.topFoods) {
+                out << symbols().text(food.first) << ' ' << food.second.calories << ' ' << food.second.entries << '\n';
+            }
+            return true;
+        }
+        bool byDay = args[1] == "day";
+        const vector<GroupTotal>& groups = byDay ? report.days : report.weeks;
+        for (size_t i = 0; i < groups.size(); ++i) {
+            if (groups[i].entries == 0) continue;
+            out << dayName(report.firstDay + i * (byDay ? 1 : 7)) << ' ' << groups[i].calories << ' '
+                << groups[i].entries << '\n';
+        }
+        return true;
+    }
+
+    if (command == "metrics") {
+        metrics().writePrometheus(out);
+        return true;
+    }
+
+    if (command == "save") {
+        foodList.saveToFiles();
+        logManager.checkpoint();
+        return true;
+    }
+
+    error = "unknown command " + string(command);
+    return false;
+}
+
+void BatchRunner::run(istream& in, ostream& out) {
+    string line;
+    string error;
+    long lineNumber = 0;
+    while (getline(in, line)) {
+        ++lineNumber;
+        if (!execute(line, out, error)) {
+            ++errors;
+            cerr << "line " << lineNumber << ": " << error << "\n";
+        }
+    }
+}
+
+RecordingStreambuf::int_type RecordingStreambuf::underflow() {
+    int_type c = source->sbumpc();
+    if (traits_type::eq_int_type(c, traits_type::eof())) {
+        return c;
+    }
+
+    current = traits_type::to_char_type(c);
+    recording.put(current);
+    if (current == '\n') {
+        recording.flush();
+    }
+    setg(&current, &current, &current + 1);
+    return c;
+}
+
+ReplayStreambuf::int_type ReplayStreambuf::underflow() {
+    int_type c = traits_type::eof();
+    if (replay) {
+        c = replay->sbumpc();
+        if (traits_type::eq_int_type(c, traits_type::eof())) {
+            replay = nullptr;
+        }
+    }
+    if (!replay) {
+        c = live->sbumpc();
+        if (traits_type::eq_int_type(c, traits_type::eof())) {
+            return c;
+        }
+    }
+
+    current = traits_type::to_char_type(c);
+    setg(&current, &current, &current + 1);
+    return c;
+}
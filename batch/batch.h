@@ -0,0 +1,71 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <bits/stdc++.h>
+#include "../food/food.h"
+#include "../log/log.h"
+#include "../profile/profile.h"
+using namespace std;
+
+// Runs the line-oriented command language against the core classes without
+// any prompts. One command per line, blank lines and '#' comments skipped:
+//   add-food <name> <calories> [keyword ...]
+//   add-composite <name> [keyword ...] | <food>:<servings> ...
+//   log <food> <servings> [YYYY-MM-DD | epoch-seconds]
+//   delete <entry-number>
+//   undo | redo
+//   search any|all <keyword ...>
+//   find <word ...>
+//   summary [YYYY-MM-DD] [method]
+//   target [method]
+//   report <from YYYY-MM-DD> <to YYYY-MM-DD>
+//   report-by day|week|food <from YYYY-MM-DD> <to YYYY-MM-DD> [top-count]
+//   metrics
+//   save
+class BatchRunner {
+public:
+    BatchRunner(FoodList& foodList, LogManager& logManager, DietProfile& profile);
+    bool execute(string_view line, ostream& out, string& error);
+    void run(istream& in, ostream& out);
+    long commandCount() const { return commands; }
+    long errorCount() const { return errors; }
+
+private:
+    FoodList& foodList;
+    LogManager& logManager;
+    DietProfile& profile;
+    long commands = 0;
+    long errors = 0;
+};
+
+// Input buffer that hands out everything read from source and also copies
+// it to a recording, flushed line by line so it survives a crash
+class RecordingStreambuf : public streambuf {
+public:
+    RecordingStreambuf(streambuf* source, ostream& recording) : source(source), recording(recording) {}
+
+protected:
+    int_type underflow() override;
+
+private:
+    streambuf* source;
+    ostream& recording;
+    char current;
+};
+
+// Input buffer that reads a recorded session first and then carries on
+// with the live input
+class ReplayStreambuf : public streambuf {
+public:
+    ReplayStreambuf(streambuf* replay, streambuf* live) : replay(replay), live(live) {}
+
+protected:
+    int_type underflow() override;
+
+private:
+    streambuf* replay;
+    streambuf* live;
+    char current;
+};
+
+#endif // BATCH_H
@@ -0,0 +1,200 @@
+#include "generator.h"
+#include "../food/food.h"
+#include "../log/log.h"
+#include "../analytics/analytics.h"
+#include "../profile/targets.h"
+#include <filesystem>
+
+// Discards whatever the code under test prints
+class NullStreambuf : public streambuf {
+protected:
+    int_type overflow(int_type c) override { return c; }
+    streamsize xsputn(const char*, streamsize n) override { return n; }
+};
+
+struct BenchResult {
+    string name;
+    long iterations;
+    double totalSeconds;
+};
+
+static vector<BenchResult> results;
+
+// Times iterations calls of body and records the result
+template <typename Body>
+static void measure(const string& name, long iterations, Body body) {
+    auto start = chrono::steady_clock::now();
+    for (long i = 0; i < iterations; ++i) {
+        body(i);
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    results.push_back({name, iterations, seconds});
+}
+
+static void printJson(ostream& out, const DatasetConfig& config, const string& scale) {
+    out << "{\n  \"scale\": \"" << scale << "\",\n"
+        << "  \"config\": {\"basic_foods\": " << config.basicFoods << ", \"composite_foods\": " << config.compositeFoods
+        << ", \"log_entries\": " << config.logEntries << ", \"years\": " << config.years
+        << ", \"profiles\": " << config.profiles << ", \"seed\": " << config.seed << "},\n"
+        << "  \"results\": [\n";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const BenchResult& result = results[i];
+        out << "    {\"name\": \"" << result.name << "\", \"iterations\": " << result.iterations
+            << ", \"total_ms\": " << fixed << setprecision(3) << result.totalSeconds * 1e3
+            << ", \"ns_per_op\": " << setprecision(1) << result.totalSeconds * 1e9 / result.iterations
+            << ", \"ops_per_sec\": " << setprecision(1) << result.iterations / max(result.totalSeconds, 1e-12) << "}"
+            << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    out << "  ]\n}\n";
+}
+
+int main(int argc, char* argv[]) {
+    DatasetConfig config;
+    string scale = "small";
+    string dir = "bench_data";
+    long queries = 10000;
+
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (i + 1 >= argc) {
+            cerr << "Missing value for " << arg << "\n";
+            return 1;
+        }
+        string value = argv[++i];
+        if (arg == "--scale") scale = value;
+        else if (arg == "--dir") dir = value;
+        else if (arg == "--seed") config.seed = stoull(value);
+        else if (arg == "--foods") config.basicFoods = stol(value);
+        else if (arg == "--composites") config.compositeFoods = stol(value);
+        else if (arg == "--entries") config.logEntries = stol(value);
+        else if (arg == "--years") config.years = stoi(value);
+        else if (arg == "--profiles") config.profiles = stol(value);
+        else if (arg == "--queries") queries = stol(value);
+        else {
+            cerr << "Usage: " << argv[0] << " [--scale small|medium|large] [--dir path] [--seed n] [--foods n]"
+                 << " [--composites n] [--entries n] [--years n] [--profiles n] [--queries n]\n";
+            return 1;
+        }
+        // A named scale sets every count, explicit counts given after it win
+        if (arg == "--scale") {
+            long n = scale == "large" ? 10000000 : scale == "medium" ? 100000 : 1000;
+            config.basicFoods = n;
+            config.compositeFoods = n / 10;
+            config.logEntries = n;
+            config.years = scale == "large" ? 10 : scale == "medium" ? 5 : 1;
+            config.profiles = n;
+        }
+    }
+
+    DatasetGenerator generator(config);
+    measure("generate_dataset", 1, [&](long) { generator.writeFiles(dir); });
+    ProfileColumns profiles = generator.makeProfiles();
+    filesystem::current_path(dir);
+
+    // The code under test prints menus and logs to cout, which would mix
+    // with the JSON report, so it is muted until the report is written
+    NullStreambuf nullBuffer;
+    streambuf* stdoutBuffer = cout.rdbuf(&nullBuffer);
+
+    FoodList foodList;
+    LogManager logManager;
+    measure("food_load_text", 1, [&](long) { foodList.loadFromFiles(); });
+    measure("food_load_snapshot", 1, [&](long) { FoodList fresh; fresh.loadFromFiles(); });
+    measure("log_load", 1, [&](long) { logManager.loadFromFile(); });
+    logManager.bindFoods(foodList);
+    // The first load split log.txt into monthly partitions; a second one
+    // reads only the manifest and the recent months
+    LogManager partitionedLog;
+    measure("log_load_partitions", 1, [&](long) { partitionedLog.loadFromFile(); });
+
+    vector<vector<string>> queryWords(queries);
+    for (auto& words : queryWords) {
+        for (int k = 0; k < 2; ++k) {
+            words.push_back(generator.pickKeyword());
+        }
+    }
+    long matches = 0;
+    measure("search_any", queries, [&](long i) { matches += foodList.searchByKeywords(queryWords[i], false).size(); });
+    measure("search_all", queries, [&](long i) { matches += foodList.searchByKeywords(queryWords[i], true).size(); });
+    // One keyword rendered a page at a time, as the search menu shows it
+    ostringstream rendered;
+    measure("search_page", queries, [&](long i) {
+        rendered.str("");
+        BufferedWriter out(rendered);
+        matches += foodList.forEachMatch({queryWords[i][0]}, false, 0, 20,
+                                         [&](FoodId, const Food& food) { food.print(out); });
+    });
+
+    // Ranked queries mix a truncated keyword with one carrying a typo
+    vector<string> rankedQueries(queries);
+    for (long i = 0; i < queries; ++i) {
+        string prefix = queryWords[i][0].substr(0, max<size_t>(3, queryWords[i][0].size() - 2));
+        string typo = queryWords[i][1];
+        swap(typo[typo.size() / 2], typo[typo.size() / 2 - 1]);
+        rankedQueries[i] = prefix + " " + typo;
+    }
+    measure("search_ranked", queries, [&](long i) { matches += foodList.searchFoods(rankedQueries[i], 10).size(); });
+
+    time_t first = generator.firstDate();
+    long span = generator.lastDate() - first;
+    mt19937_64 random(config.seed);
+    vector<time_t> dates(queries);
+    for (auto& date : dates) {
+        date = first + static_cast<time_t>(random() % span);
+    }
+    long calories = 0;
+    measure("get_total_calories", queries, [&](long i) { calories += logManager.getTotalCalories(dates[i]); });
+    measure("range_calories", queries, [&](long i) { calories += logManager.getTotalCalories(dates[i] - 30 * 86400, dates[i]); });
+    measure("view_log", queries, [&](long i) { logManager.viewLog(dates[i]); });
+    // Whole history by day, week and food; the first run loads every month
+    buildCalorieReport(logManager, first, generator.lastDate());
+    measure("group_report", 10, [&](long) { calories += buildCalorieReport(logManager, first, generator.lastDate()).calories; });
+
+    const Food& food = foodList.getFoods().front();
+    long edits = min(queries, 1000L);
+    measure("add_entry", edits, [&](long i) { logManager.addEntry(0, food.name, 1, food.calories, dates[i]); });
+    measure("undo", edits, [&](long) { logManager.undo(); });
+
+    // Reader threads search and report on pinned versions while this thread
+    // keeps adding entries, each of which publishes a new log version
+    const Published<FoodCatalog>& catalog = foodList.catalog();
+    const Published<LogView>& logView = logManager.view();
+    measure("add_entry_published", edits, [&](long i) { logManager.addEntry(0, food.name, 1, food.calories, dates[i]); });
+    long readers = max(2u, thread::hardware_concurrency());
+    atomic<long> snapshotMatches{0}, snapshotCalories{0};
+    auto readStart = chrono::steady_clock::now();
+    vector<thread> readerThreads;
+    for (long r = 0; r < readers; ++r) {
+        readerThreads.emplace_back([&, r] {
+            Published<FoodCatalog>::Reader foods(catalog);
+            Published<LogView>::Reader log(logView);
+            long found = 0, total = 0;
+            for (long i = r; i < queries; i += readers) {
+                found += foods.get().searchByKeywords(queryWords[i], false).size();
+                total += log.get().getTotalCalories(dates[i] - 30 * 86400, dates[i]);
+            }
+            snapshotMatches += found;
+            snapshotCalories += total;
+        });
+    }
+    for (long i = 0; i < edits; ++i) {
+        logManager.addEntry(0, food.name, 1, food.calories, dates[i]);
+    }
+    for (auto& reader : readerThreads) {
+        reader.join();
+    }
+    results.push_back({"snapshot_reads", queries, chrono::duration<double>(chrono::steady_clock::now() - readStart).count()});
+    // Foods do not change meanwhile, so the matches are deterministic
+    matches += snapshotMatches;
+
+    vector<int> targets(profiles.size());
+    measure("compute_targets", 1, [&](long) { computeTargetCalories(profiles, targets.data()); });
+
+    measure("food_save", 1, [&](long) { foodList.saveToFiles(true); });
+    measure("log_save", 1, [&](long) { logManager.checkpoint(); });
+
+    cout.rdbuf(stdoutBuffer);
+    cerr << "checksum " << matches + calories + accumulate(targets.begin(), targets.end(), 0L) << "\n";
+    printJson(cout, config, scale);
+    return 0;
+}
@@ -0,0 +1,229 @@
+#include "generator.h"
+#include "../food/food.h"
+#include "../log/log.h"
+#include "../analytics/analytics.h"
+#include "../food/catalog.h"
+#include <filesystem>
+
+// Consistency checks that compare the optimized paths against plain
+// recomputation. Build it as it is, with -DYADA_NO_SIMD for the scalar
+// kernels, and with -fsanitize=address,undefined or -fsanitize=thread.
+// Prints one line per check and exits with 1 if any of them failed.
+
+// Discards whatever the code under test prints
+class NullStreambuf : public streambuf {
+protected:
+    int_type overflow(int_type c) override { return c; }
+    streamsize xsputn(const char*, streamsize n) override { return n; }
+};
+
+static int failedChecks = 0;
+
+static void report(const string& name, long mismatches) {
+    cerr << name << ": " << (mismatches == 0 ? "ok" : "FAILED, " + to_string(mismatches) + " mismatches") << "\n";
+    if (mismatches != 0) ++failedChecks;
+}
+
+// sumColumn, minMaxColumn and sumSortedGroups against plain loops, over
+// lengths around the eight-lane blocks and values near the int32 limits
+static long checkKernels(mt19937_64& random) {
+    long mismatches = 0;
+    for (int round = 0; round < 2000; ++round) {
+        size_t count = random() % 100;
+        vector<int32_t> values(count), keys(count);
+        int32_t key = static_cast<int32_t>(random() % 50) - 25;
+        for (size_t i = 0; i < count; ++i) {
+            values[i] = static_cast<int32_t>(random() % 2000001) - 1000000;
+            if (random() % 3 == 0) key += random() % 3;
+            keys[i] = key;
+        }
+        if (sumColumn(values.data(), count) != accumulate(values.begin(), values.end(), 0L)) ++mismatches;
+        if (count > 0) {
+            int32_t low, high;
+            minMaxColumn(values.data(), count, low, high);
+            if (low != *min_element(values.begin(), values.end()) ||
+                high != *max_element(values.begin(), values.end())) {
+                ++mismatches;
+            }
+            int32_t firstKey = keys.front() - static_cast<int32_t>(random() % 3);
+            vector<GroupTotal> groups(keys.back() - firstKey + 1), expected(groups.size());
+            sumSortedGroups(keys.data(), values.data(), count, firstKey, groups);
+            for (size_t i = 0; i < count; ++i) {
+                expected[keys[i] - firstKey].calories += values[i];
+                ++expected[keys[i] - firstKey].entries;
+            }
+            for (size_t i = 0; i < groups.size(); ++i) {
+                if (groups[i].calories != expected[i].calories || groups[i].entries != expected[i].entries) {
+                    ++mismatches;
+                    break;
+                }
+            }
+        }
+    }
+    // A sum past the int32 range must not wrap
+    vector<int32_t> large(1 << 16, numeric_limits<int32_t>::max());
+    if (sumColumn(large.data(), large.size()) != long(numeric_limits<int32_t>::max()) * long(large.size())) ++mismatches;
+    return mismatches;
+}
+
+struct TextEntry {
+    string name;
+    int calories;
+    int day;
+};
+
+// The generated data/log.txt, read before the log converts it
+static vector<TextEntry> readTextLog(const string& filename) {
+    vector<TextEntry> entries;
+    ifstream in(filename);
+    string line;
+    while (getline(in, line)) {
+        vector<string> fields;
+        stringstream stream(line);
+        for (string field; getline(stream, field, '|');) fields.push_back(field);
+        if (fields.size() != 4) continue;
+        entries.push_back({fields[0], stoi(fields[2]), LogManager::localDay(stol(fields[3]))});
+    }
+    return entries;
+}
+
+// buildCalorieReport against sums over the text log
+static long checkReport(LogManager& log, const vector<TextEntry>& entries, time_t from, time_t to) {
+    CalorieReport report = buildCalorieReport(log, from, to, 10);
+    vector<GroupTotal> days(report.days.size());
+    map<string, GroupTotal> foods;
+    long calories = 0;
+    int count = 0;
+    for (const auto& entry : entries) {
+        if (entry.day < report.firstDay || entry.day > report.lastDay) continue;
+        days[entry.day - report.firstDay].calories += entry.calories;
+        ++days[entry.day - report.firstDay].entries;
+        foods[entry.name].calories += entry.calories;
+        ++foods[entry.name].entries;
+        calories += entry.calories;
+        ++count;
+    }
+
+    long mismatches = (report.calories != calories) + (report.entries != count);
+    for (size_t day = 0; day < days.size(); ++day) {
+        const GroupTotal& group = report.days[day];
+        mismatches += group.calories != days[day].calories || group.entries != days[day].entries;
+        const GroupTotal& week = report.weeks[day / 7];
+        if (day % 7 == 0) {
+            long weekCalories = 0;
+            for (size_t d = day; d < min(day + 7, days.size()); ++d) weekCalories += days[d].calories;
+            mismatches += week.calories != weekCalories;
+        }
+    }
+    long previous = numeric_limits<long>::max();
+    for (const auto& food : report.topFoods) {
+        const GroupTotal& expected = foods[string(symbols().text(food.first))];
+        mismatches += food.second.calories != expected.calories || food.second.entries != expected.entries;
+        mismatches += food.second.calories > previous;
+        previous = food.second.calories;
+    }
+    long best = 0;
+    for (const auto& food : foods) best = max(best, food.second.calories);
+    mismatches += !report.topFoods.empty() && report.topFoods.front().second.calories != best;
+    return mismatches;
+}
+
+// Published versions against the live structures, then readers checking
+// pinned versions while this thread keeps changing the log
+static long checkPublished(FoodList& foodList, LogManager& log, DatasetGenerator& generator, mt19937_64& random) {
+    long mismatches = 0;
+    const Published<FoodCatalog>& catalog = foodList.catalog();
+    const Published<LogView>& view = log.view();
+    vector<vector<string>> queries(200);
+    for (auto& words : queries) {
+        words.resize(1 + random() % 3);
+        for (auto& word : words) word = generator.pickKeyword();
+    }
+    shared_ptr<const FoodCatalog> foods = catalog.pin();
+    for (const auto& words : queries) {
+        for (bool matchAll : {false, true}) {
+            mismatches += foods->searchByKeywords(words, matchAll) != foodList.searchByKeywords(words, matchAll);
+        }
+    }
+
+    time_t first = generator.firstDate();
+    long span = generator.lastDate() - first;
+    vector<time_t> dates(1000);
+    for (auto& date : dates) date = first + static_cast<time_t>(random() % span);
+    auto compareView = [&](const LogView& pinned) {
+        long differing = 0;
+        for (time_t date : dates) {
+            differing += pinned.getTotalCalories(date) != log.getTotalCalories(date);
+            differing += pinned.getTotalCalories(date - 30 * 86400, date) != log.getTotalCalories(date - 30 * 86400, date);
+            differing += pinned.getLoggedDays(date - 30 * 86400, date) != log.getLoggedDays(date - 30 * 86400, date);
+        }
+        return differing;
+    };
+    mismatches += compareView(*view.pin());
+
+    // A range total must equal the sum of its days within any one version
+    atomic<bool> writing{true};
+    atomic<long> readerMismatches{0};
+    vector<thread> readers;
+    for (int r = 0; r < 2; ++r) {
+        readers.emplace_back([&, r] {
+            Published<LogView>::Reader reader(view);
+            for (size_t i = r; writing; i = (i + 2) % dates.size()) {
+                const LogView& pinned = reader.get();
+                long days = 0;
+                for (int d = 0; d < 10; ++d) days += pinned.getTotalCalories(dates[i] - d * 86400);
+                readerMismatches += days != pinned.getTotalCalories(dates[i] - 9 * 86400, dates[i]);
+            }
+        });
+    }
+    const Food& food = foodList.getFoods().front();
+    for (int i = 0; i < 2000; ++i) {
+        log.addEntry(0, food.name, 1 + i % 3, food.calories, dates[i % dates.size()]);
+        if (i % 5 == 0) log.undo();
+    }
+    writing = false;
+    for (auto& reader : readers) reader.join();
+    mismatches += readerMismatches + compareView(*view.pin());
+    return mismatches;
+}
+
+int main(int argc, char* argv[]) {
+    DatasetConfig config;
+    string dir = "check_data";
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg == "--dir" && i + 1 < argc) dir = argv[++i];
+        else if (arg == "--seed" && i + 1 < argc) config.seed = stoull(argv[++i]);
+        else {
+            cerr << "Usage: " << argv[0] << " [--dir path] [--seed n]\n";
+            return 1;
+        }
+    }
+    mt19937_64 random(config.seed);
+
+    report(string("column kernels (") + columnKernel() + ")", checkKernels(random));
+
+    filesystem::remove_all(dir);
+    DatasetGenerator generator(config);
+    generator.writeFiles(dir);
+    filesystem::current_path(dir);
+    vector<TextEntry> textLog = readTextLog("data/log.txt");
+
+    NullStreambuf nullBuffer;
+    streambuf* stdoutBuffer = cout.rdbuf(&nullBuffer);
+    FoodList foodList;
+    LogManager log;
+    foodList.loadFromFiles();
+    log.loadFromFile();
+    log.bindFoods(foodList);
+
+    long reportMismatches = checkReport(log, textLog, generator.firstDate(), generator.lastDate());
+    for (int i = 0; i < 20; ++i) {
+        time_t from = generator.firstDate() + static_cast<time_t>(random() % (365L * 86400));
+        reportMismatches += checkReport(log, textLog, from, from + static_cast<time_t>(random() % (90L * 86400)));
+    }
+    report("grouped reports", reportMismatches);
+    report("published versions", checkPublished(foodList, log, generator, random));
+    cout.rdbuf(stdoutBuffer);
+    return failedChecks == 0 ? 0 : 1;
+}
@@ -0,0 +1,74 @@
+#include "generator.h"
+#include <filesystem>
+
+DatasetGenerator::DatasetGenerator(const DatasetConfig& config) : config(config), random(config.seed) {
+    long vocabularySize = max(100L, (config.basicFoods + config.compositeFoods) / 50);
+    words.reserve(vocabularySize);
+    for (long i = 0; i < vocabularySize; ++i) {
+        words.push_back("kw" + to_string(i));
+    }
+}
+
+string DatasetGenerator::foodName(long id) const {
+    return (id < config.basicFoods ? "food" : "dish") + to_string(id);
+}
+
+string DatasetGenerator::pickKeyword() {
+    // Cubing a uniform draw skews it towards the front of the vocabulary
+    double u = uniform_real_distribution<double>(0, 1)(random);
+    return words[static_cast<long>(u * u * u * words.size())];
+}
+
+void DatasetGenerator::writeFiles(const string& dir) {
+    filesystem::create_directories(dir + "/data");
+
+    ofstream basic(dir + "/data/basicFood.txt");
+    for (long id = 0; id < config.basicFoods; ++id) {
+        basic << foodName(id) << " " << 20 + uniform(800);
+        for (long k = 1 + uniform(4); k > 0; --k) {
+            basic << " " << pickKeyword();
+        }
+        basic << "\n";
+    }
+
+    ofstream composite(dir + "/data/complexFood.txt");
+    long totalFoods = config.basicFoods + config.compositeFoods;
+    for (long id = config.basicFoods; id < totalFoods; ++id) {
+        // Stored calories are refreshed from the recipe on load
+        composite << foodName(id) << " 0";
+        for (long k = 1 + uniform(3); k > 0; --k) {
+            composite << " " << pickKeyword();
+        }
+        composite << " |";
+        for (long k = 2 + uniform(4); k > 0; --k) {
+            composite << " " << foodName(uniform(id)) << ":" << 1 + uniform(3);
+        }
+        composite << "\n";
+    }
+
+    ofstream log(dir + "/data/log.txt");
+    time_t first = firstDate();
+    double step = double(lastDate() - first) / max(1L, config.logEntries);
+    for (long i = 0; i < config.logEntries; ++i) {
+        int servings = 1 + uniform(3);
+        log << foodName(uniform(max(1L, totalFoods))) << "|" << servings << "|" << servings * (20 + uniform(800))
+            << "|" << first + static_cast<time_t>(i * step) << "\n";
+    }
+
+    ofstream profile(dir + "/data/profile.txt");
+    profile << "Gender: male\nAge: 30\nHeight: 180\nWeight: 75\nActivity Level: moderate\n";
+
+    // Start without a journal or snapshot left over from a previous run
+    filesystem::remove(dir + "/data/log.journal");
+    filesystem::remove(dir + "/data/foods.bin");
+}
+
+ProfileColumns DatasetGenerator::makeProfiles() {
+    ProfileColumns profiles;
+    profiles.reserve(config.profiles);
+    for (long i = 0; i < config.profiles; ++i) {
+        profiles.add(static_cast<Sex>(uniform(2)), 18 + uniform(60), 150 + uniform(50), 45 + uniform(80),
+                     static_cast<ActivityLevel>(uniform(5)), static_cast<Equation>(uniform(3)));
+    }
+    return profiles;
+}
@@ -0,0 +1,40 @@
+#ifndef GENERATOR_H
+#define GENERATOR_H
+
+#include <bits/stdc++.h>
+#include "../profile/targets.h"
+using namespace std;
+
+struct DatasetConfig {
+    long basicFoods = 1000;
+    long compositeFoods = 100;
+    long logEntries = 1000;
+    int years = 1;
+    long profiles = 1000;
+    uint64_t seed = 42;
+};
+
+// Writes a synthetic dataset in the formats of data/ under dir/data. The
+// same config always produces the same files. Keywords are drawn from a
+// skewed vocabulary, so a few are common and most are rare, and composites
+// nest on earlier foods.
+class DatasetGenerator {
+public:
+    explicit DatasetGenerator(const DatasetConfig& config);
+    void writeFiles(const string& dir);
+    ProfileColumns makeProfiles();
+    string foodName(long id) const;
+    const vector<string>& vocabulary() const { return words; }
+    string pickKeyword();
+    time_t firstDate() const { return endDate - config.years * 365L * 86400; }
+    time_t lastDate() const { return endDate; }
+
+private:
+    DatasetConfig config;
+    mt19937_64 random;
+    vector<string> words;
+    static const time_t endDate = 1767225600; // 2026-01-01
+    long uniform(long n) { return uniform_int_distribution<long>(0, n - 1)(random); }
+};
+
+#endif // GENERATOR_H
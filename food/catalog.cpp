@@ -0,0 +1,135 @@
+#include "catalog.h"
+#include "food.h"
+
+void FoodCatalog::setFood(FoodId id, const Food& food) {
+    if (id == foods.size()) {
+        foods.push_back(food);
+    } else {
+        foods.set(id, food);
+    }
+}
+
+void FoodCatalog::setPostings(Symbol keyword, const vector<FoodId>& ids) {
+    if (2 * (keywordCount + 1) > keywordSlots.size()) {
+        grow();
+    }
+    string_view text = symbols().text(keyword);
+    size_t hash = std::hash<string_view>()(text);
+    size_t slot = findSlot(text, hash);
+    KeywordSlot entry = keywordSlots[slot];
+    bool added = entry.keyword == emptySlot;
+    if (added) {
+        entry = {hash, keyword, make_shared<const Postings>()};
+        ++keywordCount;
+    }
+
+    // Both lists are sorted and new foods get the highest ids, so after
+    // removals the old list stops being a prefix of the new one at its last
+    // element; otherwise only the tail is new
+    const Postings& old = *entry.postings;
+    size_t kept = old.size();
+    if (kept > ids.size() || (kept > 0 && old[kept - 1] != ids[kept - 1])) {
+        kept = 0;
+    }
+    if (kept == old.size() && kept == ids.size()) {
+        if (added) keywordSlots.set(slot, move(entry));
+        return;
+    }
+    auto next = make_shared<Postings>(kept > 0 ? old : Postings());
+    for (size_t i = kept; i < ids.size(); ++i) {
+        next->push_back(ids[i]);
+    }
+    entry.postings = move(next);
+    keywordSlots.set(slot, move(entry));
+}
+
+size_t FoodCatalog::findSlot(string_view text, size_t hash) const {
+    size_t mask = keywordSlots.size() - 1;
+    for (size_t slot = hash & mask;; slot = (slot + 1) & mask) {
+        const KeywordSlot& entry = keywordSlots[slot];
+        if (entry.keyword == emptySlot || (entry.hash == hash && symbols().text(entry.keyword) == text)) {
+            return slot;
+        }
+    }
+}
+
+void FoodCatalog::grow() {
+    // Stay at most half full so probe runs stay short
+    size_t capacity = max<size_t>(64, 2 * keywordSlots.size());
+    PersistentVector<KeywordSlot> old;
+    swap(old, keywordSlots);
+    for (size_t i = 0; i < capacity; ++i) {
+        keywordSlots.push_back(KeywordSlot());
+    }
+    for (size_t i = 0; i < old.size(); ++i) {
+        if (old[i].keyword != emptySlot) {
+            keywordSlots.set(findSlot(symbols().text(old[i].keyword), old[i].hash), old[i]);
+        }
+    }
+}
+
+const FoodCatalog::Postings* FoodCatalog::postings(const string& keyword) const {
+    if (keywordSlots.empty()) return nullptr;
+    const KeywordSlot& entry = keywordSlots[findSlot(keyword, std::hash<string_view>()(keyword))];
+    if (entry.keyword == emptySlot || entry.postings->empty()) return nullptr;
+    return entry.postings.get();
+}
+
+vector<FoodId> FoodCatalog::searchByKeywords(const vector<string>& keywords, bool matchAll) const {
+    vector<FoodId> result;
+    if (matchAll && keywords.empty()) {
+        for (FoodId id = 0; id < foods.size(); ++id) {
+            if (!foods[id].removed) result.push_back(id);
+        }
+        return result;
+    }
+
+    vector<const Postings*> lists;
+    for (const auto& keyword : keywords) {
+        const Postings* list = postings(keyword);
+        if (list) {
+            lists.push_back(list);
+        } else if (matchAll) {
+            return {};
+        }
+    }
+
+    if (!matchAll) {
+        for (const Postings* list : lists) {
+            for (size_t i = 0; i < list->size(); ++i) {
+                result.push_back((*list)[i]);
+            }
+        }
+        sort(result.begin(), result.end());
+        result.erase(unique(result.begin(), result.end()), result.end());
+        return result;
+    }
+
+    if (lists.empty()) return result;
+    // Intersect starting from the shortest list, as FoodList does
+    sort(lists.begin(), lists.end(), [](const Postings* a, const Postings* b) { return a->size() < b->size(); });
+    for (size_t i = 0; i < lists[0]->size(); ++i) {
+        result.push_back((*lists[0])[i]);
+    }
+    for (size_t l = 1; l < lists.size() && !result.empty(); ++l) {
+        const Postings& list = *lists[l];
+        size_t from = 0;
+        size_t kept = 0;
+        for (FoodId id : result) {
+            // Binary search for id in list[from, size)
+            size_t low = from, high = list.size();
+            while (low < high) {
+                size_t middle = (low + high) / 2;
+                if (list[middle] < id) low = middle + 1;
+                else high = middle;
+            }
+            from = low;
+            if (from == list.size()) break;
+            if (list[from] == id) {
+                result[kept++] = id;
+            }
+        }
+        result.resize(kept);
+    }
+    return result;
+}
@@ -0,0 +1,49 @@
+#ifndef CATALOG_H
+#define CATALOG_H
+
+#include <bits/stdc++.h>
+#include "symbols.h"
+#include "../rcu/rcu.h"
+using namespace std;
+
+using FoodId = uint32_t;
+struct Food;
+
+// Immutable version of the food list for reader threads. FoodList keeps a
+// working copy, applies each change to it and publishes a copy, which shares
+// everything the change did not touch with the versions around it.
+class FoodCatalog {
+public:
+    size_t size() const { return foods.size(); }
+    const Food& food(FoodId id) const { return foods[id]; }
+    // Ids of the live foods matching any or all of the keywords, in id order
+    vector<FoodId> searchByKeywords(const vector<string>& keywords, bool matchAll) const;
+
+    // Writer side, used by FoodList. Ids are set in increasing order from
+    // size() on when foods are added.
+    void setFood(FoodId id, const Food& food);
+    // Keeps the arena holding the foods' keywords and recipes alive
+    void setArena(shared_ptr<const Arena> foodArena) { arena = move(foodArena); }
+    void setPostings(Symbol keyword, const vector<FoodId>& ids);
+
+private:
+    using Postings = PersistentVector<FoodId>;
+    static const Symbol emptySlot = numeric_limits<Symbol>::max();
+    struct KeywordSlot {
+        size_t hash;
+        Symbol keyword = emptySlot;
+        shared_ptr<const Postings> postings;
+    };
+    PersistentVector<Food> foods;
+    shared_ptr<const Arena> arena;
+    // Linear probing over hashes of the keyword text, so readers look
+    // keywords up without going through the symbol table's lock
+    PersistentVector<KeywordSlot> keywordSlots;
+    size_t keywordCount = 0;
+
+    const Postings* postings(const string& keyword) const;
+    size_t findSlot(string_view text, size_t hash) const;
+    void grow();
+};
+
+#endif // CATALOG_H
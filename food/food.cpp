@@ -1,18 +1,35 @@
 #include "food.h"
+#include "../metrics/metrics.h"
+#include "../io/lines.h"
+#include "../io/files.h"
 #include <iostream>
 #include <sstream>
 
+// Adds servings of a food to a recipe, merging repeats of the same food
+static void addIngredient(vector<Ingredient>& ingredients, FoodId food, double quantity) {
+    for (auto& ingredient : ingredients) {
+        if (ingredient.food == food) {
+            ingredient.quantity += quantity;
+            return;
+        }
+    }
+    ingredients.push_back({food, quantity});
+}
+
 void FoodList::displayOptions() {
     while (true) {
         cout << "\nFood Database Options:\n";
         cout << "1. Add new food\n";
         cout << "2. Search foods\n";
-        cout << "3. Save database\n";
-        cout << "4. Return to main menu\n";
+        cout << "3. Edit food calories\n";
+        cout << "4. Delete food\n";
+        cout << "5. Save database\n";
+        cout << "6. Return to main menu\n";
         cout << "Enter choice: ";
         
         int choice;
         cin >> choice;
+        if (cin.fail() && cin.eof()) return;
         if (cin.fail()) {
             cin.clear();
             cin.ignore(numeric_limits<streamsize>::max(), '\n');
@@ -24,11 +41,13 @@ void FoodList::displayOptions() {
         switch (choice) {
             case 1: addFood(); break;
             case 2: searchFood(); break;
-            case 3: 
-                saveToFiles();
+            case 3: editFood(); break;
+            case 4: deleteFood(); break;
+            case 5: 
+                saveToFiles(true);
                 cout << "Database saved successfully.\n";
                 break;
-            case 4: return;
+            case 6: return;
             default: cout << "Invalid choice. Try again.\n";
         }
     }
@@ -71,18 +90,36 @@ void FoodList::addBasicFood() {
     cin >> calories;
     cin.ignore();
     
-    foods.emplace_back(name, keywords, calories, false);
+    if (addBasicFood(name, keywords, calories) == noFood) {
+        cout << "A food named " << name << " already exists.\n";
+        return;
+    }
     cout << "Basic food added successfully.\n";
 }
 
+FoodId FoodList::addBasicFood(string_view name, const vector<string>& keywords, int calories) {
+    if (findByName(name) != noFood) {
+        return noFood;
+    }
+    lock_guard<mutex> guard(stateLock);
+    foods.push_back(makeFood(name, keywords, calories, false));
+    indexFood(foods.size() - 1);
+    touch(foods.size() - 1);
+    publishCatalog();
+    return foods.size() - 1;
+}
+
 void FoodList::addCompositeFood() {
     string name;
     string keywordInput;
     vector<string> keywords;
-    int totalCalories = 0;
     
     cout << "Enter composite food name: ";
     getline(cin, name);
+    if (findByName(name) != noFood) {
+        cout << "A food named " << name << " already exists.\n";
+        return;
+    }
     
     cout << "Enter keywords (space separated): ";
     getline(cin, keywordInput);
@@ -93,48 +130,60 @@ void FoodList::addCompositeFood() {
         keywords.push_back(keyword);
     }
     
-    cout << "\nAvailable basic foods:\n";
-    int basicCount = 0;
-    for (size_t i = 0; i < foods.size(); ++i) {
-        if (!foods[i].isComposite) {
-            cout << ++basicCount << ". " << foods[i].name << " (" << foods[i].calories << " cal)\n";
+    vector<Ingredient> ingredients;
+    while (true) {
+        FoodId ingredient = selectFood("add as an ingredient", "finish");
+        if (ingredient == noFood) break;
+
+        cout << "Enter servings of " << foods[ingredient].nameText() << ": ";
+        double quantity;
+        cin >> quantity;
+        if (cin.fail()) {
+            if (cin.eof()) break;
+            cin.clear();
+            quantity = 0;
+        }
+        cin.ignore(numeric_limits<streamsize>::max(), '\n');
+        if (quantity > 0) {
+            addIngredient(ingredients, ingredient, quantity);
+        } else {
+            cout << "Servings must be positive.\n";
         }
     }
-    
-    if (basicCount == 0) {
-        cout << "No basic foods available. Please add basic foods first.\n";
-        return;
+    FoodId id = addCompositeFood(name, keywords, ingredients);
+    cout << "Composite food added successfully with " << foods[id].calories << " calories.\n";
+}
+
+Food FoodList::makeFood(string_view name, const vector<string>& keywords, int calories, bool isComposite) {
+    Food food;
+    food.name = symbols().intern(name);
+    vector<Symbol> keywordSymbols;
+    for (const auto& keyword : keywords) {
+        keywordSymbols.push_back(symbols().intern(keyword));
     }
-    
-    cout << "\nEnter numbers of basic foods to include (space separated, 0 to finish):\n";
-    vector<int> selections;
-    int selection;
-    while (cin >> selection && selection != 0) {
-        if (selection > 0 && selection <= basicCount) {
-            // Find the actual index in foods vector
-            int actualIndex = -1;
-            int count = 0;
-            for (size_t i = 0; i < foods.size(); ++i) {
-                if (!foods[i].isComposite) {
-                    if (++count == selection) {
-                        actualIndex = i;
-                        break;
-                    }
-                }
-            }
-            if (actualIndex != -1) {
-                selections.push_back(actualIndex);
-            }
-        }
+    food.keywords = arena->copy(keywordSymbols);
+    food.calories = calories;
+    food.isComposite = isComposite;
+    return food;
+}
+
+FoodId FoodList::addCompositeFood(string_view name, const vector<string>& keywords, const vector<Ingredient>& ingredients) {
+    if (findByName(name) != noFood) {
+        return noFood;
     }
-    cin.ignore();
-    
-    for (int idx : selections) {
-        totalCalories += foods[idx].calories;
+    vector<Ingredient> recipe;
+    for (const auto& ingredient : ingredients) {
+        addIngredient(recipe, ingredient.food, ingredient.quantity);
     }
-    
-    foods.emplace_back(name, keywords, totalCalories, true);
-    cout << "Composite food added successfully with " << totalCalories << " calories.\n";
+    lock_guard<mutex> guard(stateLock);
+    Food food = makeFood(name, keywords, 0, true);
+    food.ingredients = arena->copy(recipe);
+    food.calories = recipeCalories(food);
+    foods.push_back(food);
+    indexFood(foods.size() - 1);
+    touch(foods.size() - 1);
+    publishCatalog();
+    return foods.size() - 1;
 }
 
 void FoodList::searchFood() {
@@ -142,10 +191,24 @@ void FoodList::searchFood() {
     cout << "Enter keywords to search (space separated): ";
     getline(cin, keywordInput);
     
-    cout << "Match:\n1. Any keyword\n2. All keywords\nEnter choice: ";
+    cout << "Match:\n1. Any keyword\n2. All keywords\n3. Best matches (names, prefixes, typos)\nEnter choice: ";
     int choice;
     cin >> choice;
     cin.ignore();
+
+    if (choice == 3) {
+        vector<FoodMatch> matches = searchFoods(keywordInput, 10);
+        BufferedWriter out(cout);
+        out << "\nSearch Results:\n";
+        if (matches.empty()) {
+            out << "No foods found.\n";
+        }
+        for (const auto& match : matches) {
+            foods[match.food].print(out);
+            out << '\n';
+        }
+        return;
+    }
     
     istringstream iss(keywordInput);
     vector<string> keywords;
@@ -154,118 +217,736 @@ void FoodList::searchFood() {
         keywords.push_back(keyword);
     }
     
-    vector<Food> results = searchByKeywords(keywords, choice == 2);
-    
-    cout << "\nSearch Results:\n";
-    if (results.empty()) {
-        cout << "No foods found.\n";
-    } else {
-        for (const auto& food : results) {
-            food.print();
-            cout << endl;
+    // Broad keywords can match much of the catalogue, so results come a page
+    // at a time and each page visits only its own foods
+    const size_t pageSize = 20;
+    size_t page = 0;
+    while (true) {
+        size_t first = page * pageSize;
+        size_t total;
+        {
+            BufferedWriter out(cout);
+            out << "\nSearch Results:\n";
+            total = forEachMatch(keywords, choice == 2, first, pageSize, [&](FoodId, const Food& food) {
+                food.print(out);
+                out << '\n';
+            });
+            if (total == 0) {
+                out << "No foods found.\n";
+            } else if (total > pageSize) {
+                out << "Showing " << first + 1 << "-" << min(total, first + pageSize) << " of " << total << ".\n";
+            }
         }
+        if (total <= pageSize) return;
+
+        bool more = total > first + pageSize;
+        if (more) cout << "n for next page, ";
+        if (page > 0) cout << "p for previous page, ";
+        cout << "Enter to finish: ";
+        string line;
+        if (!getline(cin, line)) return;
+        if (line == "n" && more) ++page;
+        else if (line == "p" && page > 0) --page;
+        else return;
     }
 }
 
-vector<Food> FoodList::searchByKeywords(const vector<string>& keywords, bool matchAll) {
-    vector<Food> results;
-    
-    for (const auto& food : foods) {
-        bool found = matchAll;
-        
-        for (const auto& keyword : keywords) {
-            bool keywordFound = false;
-            for (const auto& foodKeyword : food.keywords) {
-                if (foodKeyword == keyword) {
-                    keywordFound = true;
-                    break;
-                }
+FoodId FoodList::selectFood(const string& action, const string& stopLabel) {
+    // Browsing pages through liveFoods and filtering asks the ranked search
+    // for just enough matches, so each step costs what it shows
+    const size_t pageSize = 10;
+    string filter;
+    size_t page = 0;
+    while (true) {
+        size_t first = page * pageSize;
+        vector<FoodId> shown;
+        bool more;
+        if (filter.empty()) {
+            for (size_t i = first; i < liveFoods.size() && i < first + pageSize; ++i) {
+                shown.push_back(liveFoods[i]);
             }
-            
-            if (matchAll) {
-                found = found && keywordFound;
-                if (!found) break;
-            } else {
-                found = found || keywordFound;
-                if (found) break;
+            more = liveFoods.size() > first + pageSize;
+        } else {
+            vector<FoodMatch> matches = searchFoods(filter, first + pageSize + 1);
+            for (size_t i = first; i < matches.size() && i < first + pageSize; ++i) {
+                shown.push_back(matches[i].food);
             }
+            more = matches.size() > first + pageSize;
         }
-        
-        if (found) {
-            results.push_back(food);
+
+        if (shown.empty()) {
+            cout << (filter.empty() ? "No foods available.\n" : "No foods match \"" + filter + "\".\n");
+        }
+        for (size_t i = 0; i < shown.size(); ++i) {
+            cout << first + i + 1 << ". " << foods[shown[i]].nameText() << " (" << foods[shown[i]].calories << " cal)\n";
+        }
+
+        cout << "Select food to " << action << " (number, text to filter, ";
+        if (more) cout << "n for next page, ";
+        if (page > 0) cout << "p for previous page, ";
+        cout << "0 to " << stopLabel << "): ";
+
+        string line;
+        if (!getline(cin, line)) return noFood;
+        size_t begin = line.find_first_not_of(" \t\r");
+        string_view input;
+        if (begin != string::npos) {
+            input = string_view(line).substr(begin, line.find_last_not_of(" \t\r") + 1 - begin);
+        }
+
+        int number;
+        if (input == "0") return noFood;
+        if (input == "n" && more) {
+            ++page;
+        } else if (input == "p" && page > 0) {
+            --page;
+        } else if (parseNumber(input, number)) {
+            if (number > static_cast<int>(first) && number <= static_cast<int>(first + shown.size())) {
+                return shown[number - first - 1];
+            }
+            cout << "Invalid selection.\n";
+        } else {
+            // Anything else, including an empty line, replaces the filter
+            filter = string(input);
+            page = 0;
         }
     }
-    
-    return results;
 }
 
-void FoodList::saveToFiles() {
-    saveToFile(basicFile, false);
-    saveToFile(compositeFile, true);
+void FoodList::deleteFood() {
+    FoodId id = selectFood("delete");
+    if (id == noFood) return;
+
+    if (removeFood(id)) {
+        cout << "Food deleted.\n";
+    } else {
+        cout << "Cannot delete " << foods[id].nameText() << ": it is an ingredient of "
+             << dependents[id].size() << " composite food(s).\n";
+    }
 }
 
-void FoodList::saveToFile(const string& filename, bool isComposite) {
-    ofstream outFile(filename);
-    if (!outFile) {
-        cerr << "Error opening file for writing: " << filename << endl;
+void FoodList::editFood() {
+    FoodId id = selectFood("edit");
+    if (id == noFood) return;
+
+    if (!foods[id].ingredients.empty()) {
+        cout << "Calories of " << foods[id].nameText() << " are computed from its ingredients.\n";
         return;
     }
-    
+
+    cout << "Enter new calories per serving: ";
+    int calories;
+    cin >> calories;
+    if (cin.fail() || calories < 0) {
+        cin.clear();
+        cin.ignore(numeric_limits<streamsize>::max(), '\n');
+        cout << "Invalid calories.\n";
+        return;
+    }
+    cin.ignore();
+
+    setCalories(id, calories);
+    cout << "Calories updated.\n";
+}
+
+vector<FoodMatch> FoodList::searchFoods(string_view query, size_t limit) {
+    YADA_TIMED("food_ranked_search");
+    // Foods only ever get appended, so catching up means indexing the tail
+    for (FoodId id = searchIndex.foodCount(); id < foods.size(); ++id) {
+        searchIndex.add(id, foods[id]);
+    }
+    return searchIndex.search(query, limit, [&](FoodId id) { return !foods[id].removed; });
+}
+
+vector<FoodId> FoodList::searchByKeywords(const vector<string>& keywords, bool matchAll) const {
+    vector<FoodId> ids;
+    forEachMatch(keywords, matchAll, 0, numeric_limits<size_t>::max(),
+                 [&](FoodId id, const Food&) { ids.push_back(id); });
+    return ids;
+}
+
+size_t FoodList::forEachMatch(const vector<string>& keywords, bool matchAll, size_t offset, size_t limit,
+                              const function<void(FoodId, const Food&)>& visit) const {
+    YADA_TIMED("food_search");
+    // With no keywords, "all" is vacuously true for every food and "any" for none
+    if (matchAll && keywords.empty()) {
+        for (size_t i = offset; i < liveFoods.size() && i - offset < limit; ++i) {
+            visit(liveFoods[i], foods[liveFoods[i]]);
+        }
+        return liveFoods.size();
+    }
+
+    vector<const vector<FoodId>*> lists;
+    for (const auto& keyword : keywords) {
+        const vector<FoodId>* list = postings(keyword);
+        if (list) {
+            lists.push_back(list);
+        } else if (matchAll) {
+            return 0;
+        }
+    }
+
+    // Every match is counted, but only those inside the window are visited
+    size_t total = 0;
+    auto match = [&](FoodId id) {
+        if (total >= offset && total - offset < limit) {
+            visit(id, foods[id]);
+        }
+        ++total;
+    };
+
+    // Walking the shortest posting list first keeps the "all" candidates
+    // from ever outnumbering the rarest keyword
+    if (matchAll) {
+        sort(lists.begin(), lists.end(), [](const vector<FoodId>* a, const vector<FoodId>* b) {
+            return a->size() < b->size();
+        });
+    }
+    vector<vector<FoodId>::const_iterator> cursors;
+    for (const auto* list : lists) {
+        cursors.push_back(list->begin());
+    }
+
+    if (matchAll) {
+        bool exhausted = false;
+        for (auto id = lists[0]->begin(); id != lists[0]->end() && !exhausted; ++id) {
+            bool inAll = true;
+            for (size_t i = 1; i < lists.size() && inAll; ++i) {
+                cursors[i] = lower_bound(cursors[i], lists[i]->end(), *id);
+                exhausted = cursors[i] == lists[i]->end();
+                inAll = !exhausted && *cursors[i] == *id;
+            }
+            if (inAll) match(*id);
+        }
+    } else {
+        // Merge the sorted posting lists, taking each id once
+        while (true) {
+            FoodId next = noFood;
+            for (size_t i = 0; i < lists.size(); ++i) {
+                if (cursors[i] != lists[i]->end()) next = min(next, *cursors[i]);
+            }
+            if (next == noFood) break;
+            match(next);
+            for (size_t i = 0; i < lists.size(); ++i) {
+                if (cursors[i] != lists[i]->end() && *cursors[i] == next) ++cursors[i];
+            }
+        }
+    }
+
+    YADA_COUNT("food_search_results", total);
+    return total;
+}
+
+const vector<FoodId>* FoodList::postings(const string& keyword) const {
+    // A word that was never interned cannot be any food's keyword
+    Symbol symbol;
+    if (!symbols().find(keyword, symbol) || symbol >= keywordIndex.size() || keywordIndex[symbol].empty()) {
+        return nullptr;
+    }
+    return &keywordIndex[symbol];
+}
+
+FoodId FoodList::idOf(Symbol name) const {
+    return nameIndex.find(symbols().text(name));
+}
+
+FoodId FoodList::findByName(string_view name) const {
+    return nameIndex.find(name);
+}
+
+void FoodList::indexFood(FoodId id) {
+    const Food& food = foods[id];
+    for (Symbol keyword : food.keywords) {
+        if (keyword >= keywordIndex.size()) {
+            keywordIndex.resize(symbols().size());
+        }
+        vector<FoodId>& list = keywordIndex[keyword];
+        // Ids are indexed in increasing order, so appending keeps the list sorted
+        if (list.empty() || list.back() != id) {
+            list.push_back(id);
+        }
+    }
+    nameIndex.insert(food.name, id);
+    // Ids are indexed in increasing order here too
+    liveFoods.push_back(id);
+
+    if (dependents.size() < foods.size()) {
+        dependents.resize(foods.size());
+    }
+    linkIngredients(id);
+}
+
+void FoodList::rebuildIndex() {
+    searchIndex.clear();
+    keywordIndex.assign(symbols().size(), {});
+    nameIndex.clear();
+    nameIndex.reserve(foods.size());
+    liveFoods.clear();
+    dependents.assign(foods.size(), {});
+    for (FoodId id = 0; id < foods.size(); ++id) {
+        if (!foods[id].removed) {
+            indexFood(id);
+        }
+    }
+}
+
+bool FoodList::removeFood(FoodId id) {
+    // Removing an ingredient would leave its composites without a recipe
+    if (!dependents[id].empty()) {
+        return false;
+    }
+
+    lock_guard<mutex> guard(stateLock);
+    Food& food = foods[id];
+    for (const auto& ingredient : food.ingredients) {
+        vector<FoodId>& users = dependents[ingredient.food];
+        users.erase(remove(users.begin(), users.end(), id), users.end());
+    }
+
+    for (Symbol keyword : food.keywords) {
+        vector<FoodId>& list = keywordIndex[keyword];
+        auto pos = lower_bound(list.begin(), list.end(), id);
+        if (pos != list.end() && *pos == id) {
+            list.erase(pos);
+        }
+    }
+
+    // The slot stays behind so every other FoodId keeps its meaning
+    food.removed = true;
+
+    nameIndex.erase(food.nameText());
+    liveFoods.erase(lower_bound(liveFoods.begin(), liveFoods.end(), id));
+    touch(id);
+    publishCatalog();
+    return true;
+}
+
+void FoodList::linkIngredients(FoodId id) {
+    for (const auto& ingredient : foods[id].ingredients) {
+        dependents[ingredient.food].push_back(id);
+    }
+}
+
+int FoodList::recipeCalories(const Food& food) const {
+    double total = 0;
+    for (const auto& ingredient : food.ingredients) {
+        total += foods[ingredient.food].calories * ingredient.quantity;
+    }
+    return lround(total);
+}
+
+void FoodList::setCalories(FoodId id, int calories) {
+    lock_guard<mutex> guard(stateLock);
+    foods[id].calories = calories;
+    touch(id);
+
+    // Collect every composite that depends on id, directly or through other
+    // composites, and count how many of its ingredients are among them
+    unordered_map<FoodId, int> pendingInputs;
+    vector<FoodId> stack = {id};
+    while (!stack.empty()) {
+        FoodId current = stack.back();
+        stack.pop_back();
+        for (FoodId user : dependents[current]) {
+            if (pendingInputs.emplace(user, 0).second) {
+                stack.push_back(user);
+            }
+        }
+    }
+    for (auto& entry : pendingInputs) {
+        for (const auto& ingredient : foods[entry.first].ingredients) {
+            if (ingredient.food == id || pendingInputs.count(ingredient.food)) {
+                ++entry.second;
+            }
+        }
+    }
+
+    // Recompute in topological order: a composite is updated only once all
+    // of its changed ingredients have been
+    vector<FoodId> ready = {id};
+    while (!ready.empty()) {
+        FoodId current = ready.back();
+        ready.pop_back();
+        for (FoodId user : dependents[current]) {
+            if (--pendingInputs[user] == 0) {
+                foods[user].calories = recipeCalories(foods[user]);
+                ready.push_back(user);
+                touch(user);
+            }
+        }
+    }
+    publishCatalog();
+}
+
+void FoodList::resolveRecipes(const vector<pair<FoodId, string_view>>& recipes) {
+    vector<Ingredient> ingredients;
+    for (const auto& recipe : recipes) {
+        FoodId id = recipe.first;
+        ingredients.assign(foods[id].ingredients.begin(), foods[id].ingredients.end());
+        FieldScanner fields(recipe.second, ' ');
+        string_view token;
+        while (fields.next(token)) {
+            size_t colon = token.rfind(':');
+            FoodId ingredient = noFood;
+            double quantity = 0;
+            if (colon != string_view::npos && parseNumber(token.substr(colon + 1), quantity)) {
+                ingredient = findByName(token.substr(0, colon));
+            }
+
+            if (ingredient == noFood || ingredient == id || quantity <= 0) {
+                cerr << "Ignoring invalid ingredient " << token << " of " << foods[id].nameText() << endl;
+                continue;
+            }
+            addIngredient(ingredients, ingredient, quantity);
+        }
+        foods[id].ingredients = arena->copy(ingredients);
+        linkIngredients(id);
+    }
+
+    // Refresh every recipe in topological order so composites pick up edits
+    // made to the text files. Whatever is never reached sits on a cycle and
+    // keeps its stored calories without a recipe.
+    vector<int> pendingInputs(foods.size());
+    vector<FoodId> ready;
+    for (FoodId id = 0; id < foods.size(); ++id) {
+        pendingInputs[id] = foods[id].ingredients.size();
+        if (pendingInputs[id] == 0) {
+            ready.push_back(id);
+        }
+    }
+    while (!ready.empty()) {
+        FoodId current = ready.back();
+        ready.pop_back();
+        if (!foods[current].ingredients.empty()) {
+            foods[current].calories = recipeCalories(foods[current]);
+        }
+        for (FoodId user : dependents[current]) {
+            if (--pendingInputs[user] == 0) {
+                ready.push_back(user);
+            }
+        }
+    }
+    for (FoodId id = 0; id < foods.size(); ++id) {
+        if (pendingInputs[id] > 0) {
+            cerr << "Ignoring cyclic recipe of " << foods[id].nameText() << endl;
+            for (const auto& ingredient : foods[id].ingredients) {
+                vector<FoodId>& users = dependents[ingredient.food];
+                users.erase(remove(users.begin(), users.end(), id), users.end());
+            }
+            foods[id].ingredients = ArenaSpan<Ingredient>();
+        }
+    }
+}
+
+void FoodList::saveToFiles(bool force) {
+    YADA_TIMED("food_save");
+    // The menu and the autosave thread may both save; they take turns, and
+    // only the copy is made under stateLock so disk writes never hold it
+    lock_guard<mutex> saving(saveLock);
+    vector<Food> copy;
+    shared_ptr<const Arena> copyArena;
+    uint64_t basicSeen, compositeSeen;
+    {
+        lock_guard<mutex> guard(stateLock);
+        basicSeen = basicVersion;
+        compositeSeen = compositeVersion;
+        if (!force && basicSeen == basicSaved && compositeSeen == compositeSaved) {
+            return;
+        }
+        // The copies' keywords and recipes stay in the arena, which a
+        // reload would otherwise drop from under them
+        copy = foods;
+        copyArena = arena;
+    }
+
+    bool basicWritten = true, compositeWritten = true;
+    if (force || basicSeen != basicSaved) {
+        basicWritten = writeFileAtomically(basicFile, formatFoods(copy, false));
+        if (basicWritten) basicSaved = basicSeen;
+    }
+    if (force || compositeSeen != compositeSaved) {
+        compositeWritten = writeFileAtomically(compositeFile, formatFoods(copy, true));
+        if (compositeWritten) compositeSaved = compositeSeen;
+    }
+    // The snapshot is stamped with the text files, so it must not claim a
+    // change that one of them failed to take
+    if (basicWritten && compositeWritten) {
+        FoodSnapshot::write(snapshotFile, copy, FileStamp::of(basicFile), FileStamp::of(compositeFile));
+    }
+}
+
+void FoodList::touch(FoodId id) {
+    ++(foods[id].isComposite ? compositeVersion : basicVersion);
+    if (publishing) {
+        unpublishedFoods.push_back(id);
+    }
+    if (changeListener) {
+        changeListener();
+    }
+}
+
+const Published<FoodCatalog>& FoodList::catalog() {
+    lock_guard<mutex> guard(stateLock);
+    if (!publishing) {
+        publishing = true;
+        republishCatalog();
+    }
+    return publishedCatalog;
+}
+
+void FoodList::republishCatalog() {
+    catalogDraft = FoodCatalog();
+    catalogDraft.setArena(arena);
+    unpublishedFoods.resize(foods.size());
+    iota(unpublishedFoods.begin(), unpublishedFoods.end(), 0);
+    publishCatalog();
+}
+
+// Applies the foods changed since the last version, and the posting lists
+// of their keywords, to the draft and publishes a copy of it
+void FoodList::publishCatalog() {
+    if (!publishing) return;
+    sort(unpublishedFoods.begin(), unpublishedFoods.end());
+    unpublishedFoods.erase(unique(unpublishedFoods.begin(), unpublishedFoods.end()), unpublishedFoods.end());
+    vector<Symbol> keywords;
+    for (FoodId id : unpublishedFoods) {
+        catalogDraft.setFood(id, foods[id]);
+        keywords.insert(keywords.end(), foods[id].keywords.begin(), foods[id].keywords.end());
+    }
+    sort(keywords.begin(), keywords.end());
+    keywords.erase(unique(keywords.begin(), keywords.end()), keywords.end());
+    const vector<FoodId> none;
+    for (Symbol keyword : keywords) {
+        catalogDraft.setPostings(keyword, keyword < keywordIndex.size() ? keywordIndex[keyword] : none);
+    }
+    unpublishedFoods.clear();
+    publishedCatalog.publish(make_shared<const FoodCatalog>(catalogDraft));
+}
+
+string FoodList::formatFoods(const vector<Food>& foods, bool isComposite) {
+    ostringstream out;
     for (const auto& food : foods) {
-        if (food.isComposite == isComposite) {
-            outFile << food.name << " " << food.calories;
-            for (const auto& keyword : food.keywords) {
-                outFile << " " << keyword;
+        if (food.isComposite == isComposite && !food.removed) {
+            out << food.nameText() << " " << food.calories;
+            for (Symbol keyword : food.keywords) {
+                out << " " << symbols().text(keyword);
+            }
+            if (!food.ingredients.empty()) {
+                out << " |";
+                for (const auto& ingredient : food.ingredients) {
+                    // Shortest text that reads back as the same double
+                    char quantity[32];
+                    char* end = to_chars(quantity, quantity + sizeof(quantity), ingredient.quantity).ptr;
+                    out << " " << foods[ingredient.food].nameText() << ":" << string_view(quantity, end - quantity);
+                }
             }
-            outFile << "\n";
+            out << "\n";
         }
     }
-    
-    outFile.close();
+    return out.str();
+}
+
+// Foods parsed from one chunk of a text file, with names, keywords and
+// recipes still pointing into the file and line numbers relative to the chunk
+struct FoodChunk {
+    struct Entry {
+        string_view name;
+        long line;
+        int calories;
+        size_t firstKeyword;
+        size_t keywordCount;
+        string_view recipe;
+    };
+    vector<Entry> foods;
+    vector<string_view> keywords;
+    vector<ParseError> errors;
+    long lines = 0;
+};
+
+static void parseFoodChunk(string_view text, FoodChunk& chunk) {
+    chunk.lines = forEachLine(text, [&](string_view line, long lineNumber) {
+        // Composite lines end with "| ingredient:servings ...", resolved by
+        // name once every food is loaded
+        FoodChunk::Entry entry;
+        entry.line = lineNumber;
+        size_t bar = line.find('|');
+        if (bar != string_view::npos) {
+            entry.recipe = line.substr(bar + 1);
+            line = line.substr(0, bar);
+        }
+
+        FieldScanner fields(line, ' ');
+        string_view calorieText;
+        if (!fields.next(entry.name)) return;
+        if (!fields.next(calorieText)) {
+            chunk.errors.push_back({lineNumber, "missing calories for " + string(entry.name)});
+            return;
+        }
+        if (!parseNumber(calorieText, entry.calories)) {
+            chunk.errors.push_back({lineNumber, "invalid calorie value '" + string(calorieText) + "'"});
+            return;
+        }
+
+        entry.firstKeyword = chunk.keywords.size();
+        string_view keyword;
+        while (fields.next(keyword)) {
+            chunk.keywords.push_back(keyword);
+        }
+        entry.keywordCount = chunk.keywords.size() - entry.firstKeyword;
+        chunk.foods.push_back(entry);
+    });
+}
+
+// Maps a food file and parses it in line-aligned chunks on several threads
+static vector<FoodChunk> parseFoodFile(const string& filename, bool isComposite, MappedFile& file) {
+    if (!file.open(filename)) {
+        cerr << "File not found, starting with empty " << (isComposite ? "composite" : "basic")
+             << " food database: " << filename << endl;
+        return {};
+    }
+    return parseChunks<FoodChunk>(lineChunks(file.text()), parseFoodChunk);
 }
 
 void FoodList::loadFromFiles() {
+    YADA_TIMED("food_load");
+    // Versions already published or being saved keep the old arena alive
     foods.clear();
-    loadFromFile(basicFile, false);
-    loadFromFile(compositeFile, true);
+    arena = make_shared<Arena>();
+    nameIndex.clear();
+    FileStamp basicStamp = FileStamp::of(basicFile);
+    FileStamp compositeStamp = FileStamp::of(compositeFile);
+
+    FoodSnapshot snapshot;
+    if (snapshot.open(snapshotFile, basicStamp, compositeStamp)) {
+        if (snapshot.verify()) {
+            loadFromSnapshot(snapshot);
+            if (publishing) republishCatalog();
+            return;
+        }
+        cerr << "Food snapshot is damaged, reading the text files: " << snapshotFile << endl;
+    }
+
+    // Both files are parsed side by side, then appended basic first so food
+    // ids come out as in a sequential load. The mappings back the recipe
+    // views until they are resolved.
+    MappedFile basicText, compositeText;
+    vector<FoodChunk> basicChunks;
+    auto basicParse = async(launch::async, [&] { basicChunks = parseFoodFile(basicFile, false, basicText); });
+    vector<FoodChunk> compositeChunks = parseFoodFile(compositeFile, true, compositeText);
+    basicParse.get();
+
+    vector<pair<FoodId, string_view>> recipes;
+    appendFoods(basicFile, basicChunks, false, recipes);
+    appendFoods(compositeFile, compositeChunks, true, recipes);
+    rebuildIndex();
+    resolveRecipes(recipes);
+    FoodSnapshot::write(snapshotFile, foods, basicStamp, compositeStamp);
+    if (publishing) republishCatalog();
 }
 
-void FoodList::loadFromFile(const string& filename, bool isComposite) {
-    ifstream inFile(filename);
-    if (!inFile) {
-        cerr << "File not found, starting with empty " << (isComposite ? "composite" : "basic") 
-             << " food database: " << filename << endl;
-        return;
+void FoodList::loadFromSnapshot(const FoodSnapshot& snapshot) {
+    // Each distinct keyword is interned once, then foods refer to it by position
+    vector<Symbol> keywordSymbols(snapshot.keywordCount());
+    for (uint32_t k = 0; k < snapshot.keywordCount(); ++k) {
+        keywordSymbols[k] = symbols().intern(snapshot.keyword(k));
     }
-    
-    string line;
-    while (getline(inFile, line)) {
-        istringstream iss(line);
-        vector<string> tokens;
-        string token;
-        
-        while (iss >> token) {
-            tokens.push_back(token);
+
+    uint32_t count = snapshot.foodCount();
+    foods.reserve(count);
+    nameIndex.clear();
+    nameIndex.reserve(count);
+    liveFoods.clear();
+    liveFoods.reserve(count);
+    searchIndex.clear();
+    vector<Symbol> keywords;
+    vector<Ingredient> ingredients;
+    for (uint32_t i = 0; i < count; ++i) {
+        Food food;
+        food.name = symbols().intern(snapshot.foodName(i));
+        food.calories = snapshot.foodCalories(i);
+        food.isComposite = snapshot.foodIsComposite(i);
+        keywords.clear();
+        for (uint32_t k = 0; k < snapshot.foodKeywordCount(i); ++k) {
+            keywords.push_back(keywordSymbols[snapshot.foodKeywordIndex(i, k)]);
         }
-        
-        if (tokens.size() >= 2) {
-            string name = tokens[0];
-            int calories;
-            try {
-                calories = stoi(tokens[1]);
-            } catch (...) {
-                cerr << "Invalid calorie value in file: " << tokens[1] << endl;
+        food.keywords = arena->copy(keywords);
+        ingredients.clear();
+        for (uint32_t k = 0; k < snapshot.foodIngredientCount(i); ++k) {
+            double quantity;
+            FoodId ingredient = snapshot.foodIngredient(i, k, quantity);
+            ingredients.push_back({ingredient, quantity});
+        }
+        food.ingredients = arena->copy(ingredients);
+        nameIndex.insert(food.name, i);
+        liveFoods.push_back(i);
+        foods.push_back(food);
+    }
+
+    // The keyword index is taken over as stored instead of being rebuilt
+    keywordIndex.assign(symbols().size(), {});
+    for (uint32_t k = 0; k < snapshot.keywordCount(); ++k) {
+        uint32_t postingCount;
+        const uint32_t* postings = snapshot.postings(k, postingCount);
+        keywordIndex[keywordSymbols[k]].assign(postings, postings + postingCount);
+    }
+
+    dependents.assign(foods.size(), {});
+    for (FoodId id = 0; id < foods.size(); ++id) {
+        linkIngredients(id);
+    }
+}
+
+void FoodList::appendFoods(const string& filename, vector<FoodChunk>& chunks, bool isComposite,
+                           vector<pair<FoodId, string_view>>& recipes) {
+    // Names are interned here, in file order, since the symbol table would
+    // serialize the workers anyway
+    vector<ParseError> errors;
+    long lineOffset = 0;
+    vector<Symbol> keywords;
+    for (auto& chunk : chunks) {
+        for (const auto& entry : chunk.foods) {
+            // A repeated name keeps the first food and its calories, picking
+            // up any keywords the repeat adds
+            FoodId existing = nameIndex.find(entry.name);
+            if (existing != noFood) {
+                Food& first = foods[existing];
+                keywords.assign(first.keywords.begin(), first.keywords.end());
+                for (size_t i = 0; i < entry.keywordCount; ++i) {
+                    Symbol keyword = symbols().intern(chunk.keywords[entry.firstKeyword + i]);
+                    if (find(keywords.begin(), keywords.end(), keyword) == keywords.end()) {
+                        keywords.push_back(keyword);
+                    }
+                }
+                if (keywords.size() != first.keywords.size()) {
+                    first.keywords = arena->copy(keywords);
+                }
+                errors.push_back({lineOffset + entry.line, "duplicate food " + string(entry.name) +
+                                                               " merged into the first one"});
                 continue;
             }
-            
-            vector<string> keywords;
-            if (tokens.size() > 2) {
-                keywords.assign(tokens.begin() + 2, tokens.end());
+
+            Food food;
+            food.name = symbols().intern(entry.name);
+            food.calories = entry.calories;
+            food.isComposite = isComposite;
+            keywords.clear();
+            for (size_t i = 0; i < entry.keywordCount; ++i) {
+                keywords.push_back(symbols().intern(chunk.keywords[entry.firstKeyword + i]));
             }
-            
-            foods.emplace_back(name, keywords, calories, isComposite);
+            food.keywords = arena->copy(keywords);
+
+            nameIndex.insert(food.name, foods.size());
+            foods.push_back(food);
+            if (isComposite && !entry.recipe.empty()) {
+                recipes.emplace_back(foods.size() - 1, entry.recipe);
+            }
+        }
+        for (auto error : chunk.errors) {
+            error.line += lineOffset;
+            errors.push_back(error);
         }
+        lineOffset += chunk.lines;
     }
-    
-    inFile.close();
+    stable_sort(errors.begin(), errors.end(), [](const ParseError& a, const ParseError& b) { return a.line < b.line; });
+    reportErrors(filename, errors);
 }
\ No newline at end of file
@@ -2,51 +2,138 @@
 #define FOOD_H
 
 #include <bits/stdc++.h>
+#include "symbols.h"
+#include "snapshot.h"
+#include "search.h"
+#include "nameindex.h"
+#include "catalog.h"
+#include "../io/lines.h"
+#include "../arena/arena.h"
 using namespace std;
 
+// Position of a food in FoodList; stays valid for the whole session, as
+// deleted foods leave a removed slot behind instead of shifting the rest
+using FoodId = uint32_t;
+const FoodId noFood = numeric_limits<FoodId>::max();
+
+// One edge of a composite's recipe: servings of another food
+struct Ingredient {
+    FoodId food;
+    double quantity;
+};
+
+// Fixed-size record of one food. Its keyword list and recipe live in the
+// FoodList's arena, so foods copy cheaply and need no allocation of their own.
 struct Food {
-    string name;
-    vector<string> keywords;
-    int calories;
-    bool isComposite;
-
-    Food(string name = "", vector<string> keywords = {}, int calories = 0, bool isComposite = false) {
-        this->name = name;
-        this->keywords = keywords;
-        this->calories = calories;
-        this->isComposite = isComposite;
-    }
+    Symbol name = 0;
+    ArenaSpan<Symbol> keywords;
+    int calories = 0;
+    bool isComposite = false;
+    bool removed = false;
+    // Distinct ingredients of a composite; empty for basic foods and for
+    // composites saved before recipes were kept, whose calories are fixed
+    ArenaSpan<Ingredient> ingredients;
+
+    string_view nameText() const { return symbols().text(name); }
 
-    void print() const {
-        cout << "Name: " << name << endl;
-        cout << "Type: " << (isComposite ? "Composite" : "Basic") << endl;
-        cout << "Keywords: ";
-        for (const auto& keyword : keywords) {
-            cout << keyword << " ";
+    void print(BufferedWriter& out) const {
+        out << "Name: " << nameText() << '\n';
+        out << "Type: " << (isComposite ? "Composite" : "Basic") << '\n';
+        out << "Keywords: ";
+        for (Symbol keyword : keywords) {
+            out << symbols().text(keyword) << ' ';
         }
-        cout << endl;
-        cout << "Calories: " << calories << endl;
+        out << '\n';
+        out << "Calories: " << calories << '\n';
     }
 };
 
+struct FoodChunk;
+
 class FoodList {
 public:
     void addFood();
     void searchFood();
+    void deleteFood();
+    void editFood();
     void displayOptions();
-    void saveToFiles();
+    // Rewrites the files whose foods changed since the last save, or all of them
+    void saveToFiles(bool force = false);
     void loadFromFiles();
+    FoodId addBasicFood(string_view name, const vector<string>& keywords, int calories);
+    FoodId addCompositeFood(string_view name, const vector<string>& keywords, const vector<Ingredient>& ingredients);
+    // Ids of the live foods matching any or all of the keywords, in id order
+    vector<FoodId> searchByKeywords(const vector<string>& keywords, bool matchAll) const;
+    // Hands the matches from offset on, at most limit of them, to visit
+    // without copying any food; returns how many foods match in all
+    size_t forEachMatch(const vector<string>& keywords, bool matchAll, size_t offset, size_t limit,
+                        const function<void(FoodId, const Food&)>& visit) const;
+    vector<FoodMatch> searchFoods(string_view query, size_t limit);
     const vector<Food>& getFoods() const { return foods; }
+    FoodId idOf(Symbol name) const;
+    FoodId findByName(string_view name) const;
+    FoodId selectFood(const string& action, const string& stopLabel = "cancel");
+    // Called after every change, e.g. to wake an autosave thread
+    void setChangeListener(function<void()> listener) { changeListener = move(listener); }
+    // Versions of the food list for reader threads. The first call publishes
+    // the current foods; from then on every change publishes a new version.
+    const Published<FoodCatalog>& catalog();
     
 private:
     vector<Food> foods;
+    // Holds the foods' keyword lists and recipes. Replaced on reload; catalog
+    // versions and saves in flight share the old one until they are done.
+    shared_ptr<Arena> arena = make_shared<Arena>();
+    // Held while foods change and while a save copies them, so saves can run
+    // on another thread; the menu thread reads without it
+    mutable mutex stateLock;
+    mutex saveLock;
+    // Bumped by every change to the foods stored in each file; a save only
+    // rewrites the files whose version moved since it last wrote them
+    atomic<uint64_t> basicVersion{0};
+    atomic<uint64_t> compositeVersion{0};
+    uint64_t basicSaved = 0;
+    uint64_t compositeSaved = 0;
+    function<void()> changeListener;
+    // Working copy of the next catalog version and the foods changed since
+    // the last one was published; only kept up once catalog() was called
+    Published<FoodCatalog> publishedCatalog;
+    FoodCatalog catalogDraft;
+    bool publishing = false;
+    vector<FoodId> unpublishedFoods;
+    // keyword symbol -> ids of the live foods carrying it, kept sorted
+    vector<vector<FoodId>> keywordIndex;
+    // name -> id of the live food with that name; names are unique ignoring case
+    NameIndex nameIndex;
+    // Ids of the live foods in increasing order, for paging through them
+    vector<FoodId> liveFoods;
+    // food -> composites listing it as an ingredient, so the recipe graph
+    // can be walked upwards from a changed food
+    vector<vector<FoodId>> dependents;
+    // Name and keyword terms for ranked search, caught up lazily on each query
+    FoodSearchIndex searchIndex;
     string basicFile = "data/basicFood.txt";
     string compositeFile = "data/complexFood.txt";
+    // Binary image of both files, rebuilt whenever it no longer matches them
+    string snapshotFile = "data/foods.bin";
     void addBasicFood();
     void addCompositeFood();
-    vector<Food> searchByKeywords(const vector<string>& keywords, bool matchAll);
-    void saveToFile(const string& filename, bool isComposite);
-    void loadFromFile(const string& filename, bool isComposite);
+    Food makeFood(string_view name, const vector<string>& keywords, int calories, bool isComposite);
+    const vector<FoodId>* postings(const string& keyword) const;
+    void indexFood(FoodId id);
+    void rebuildIndex();
+    bool removeFood(FoodId id);
+    void linkIngredients(FoodId id);
+    int recipeCalories(const Food& food) const;
+    void setCalories(FoodId id, int calories);
+    void resolveRecipes(const vector<pair<FoodId, string_view>>& recipes);
+    void touch(FoodId id);
+    void publishCatalog();
+    void republishCatalog();
+    static string formatFoods(const vector<Food>& foods, bool isComposite);
+    void appendFoods(const string& filename, vector<FoodChunk>& chunks, bool isComposite,
+                     vector<pair<FoodId, string_view>>& recipes);
+    void loadFromSnapshot(const FoodSnapshot& snapshot);
 };
 
-#endif // FOOD_H
\ No newline at end of file
+#endif // FOOD_H
@@ -0,0 +1,96 @@
+#include "nameindex.h"
+
+static char lower(char c) {
+    return tolower(static_cast<unsigned char>(c));
+}
+
+// FNV-1a over the lower-cased bytes
+uint32_t NameIndex::hashName(string_view name) {
+    uint32_t hash = 2166136261u;
+    for (char c : name) {
+        hash = (hash ^ static_cast<uint8_t>(lower(c))) * 16777619u;
+    }
+    return hash;
+}
+
+bool NameIndex::sameName(string_view a, string_view b) {
+    if (a.size() != b.size()) return false;
+    for (size_t i = 0; i < a.size(); ++i) {
+        if (lower(a[i]) != lower(b[i])) return false;
+    }
+    return true;
+}
+
+void NameIndex::clear() {
+    slots.clear();
+    count = 0;
+}
+
+void NameIndex::reserve(size_t wanted) {
+    // Stay at most half full so probe runs stay short
+    size_t capacity = 16;
+    while (capacity < 2 * wanted) capacity *= 2;
+    if (capacity > slots.size()) {
+        grow(capacity);
+    }
+}
+
+void NameIndex::grow(size_t capacity) {
+    vector<Slot> old(capacity);
+    old.swap(slots);
+    size_t mask = slots.size() - 1;
+    for (const Slot& slot : old) {
+        if (slot.food == emptySlot) continue;
+        size_t i = slot.hash & mask;
+        while (slots[i].food != emptySlot) i = (i + 1) & mask;
+        slots[i] = slot;
+    }
+}
+
+// Index of the slot holding name, or of the empty slot that ends its probe run
+size_t NameIndex::findSlot(string_view name, uint32_t hash) const {
+    size_t mask = slots.size() - 1;
+    size_t i = hash & mask;
+    while (slots[i].food != emptySlot &&
+           (slots[i].hash != hash || !sameName(symbols().text(slots[i].name), name))) {
+        i = (i + 1) & mask;
+    }
+    return i;
+}
+
+FoodId NameIndex::find(string_view name) const {
+    if (slots.empty()) return emptySlot;
+    return slots[findSlot(name, hashName(name))].food;
+}
+
+bool NameIndex::insert(Symbol name, FoodId id) {
+    reserve(count + 1);
+    string_view text = symbols().text(name);
+    uint32_t hash = hashName(text);
+    Slot& slot = slots[findSlot(text, hash)];
+    if (slot.food != emptySlot) {
+        return false;
+    }
+    slot = {hash, name, id};
+    ++count;
+    return true;
+}
+
+void NameIndex::erase(string_view name) {
+    if (slots.empty()) return;
+    size_t mask = slots.size() - 1;
+    size_t hole = findSlot(name, hashName(name));
+    if (slots[hole].food == emptySlot) return;
+
+    // Backward-shift deletion: pull later entries of the run into the hole
+    // unless their home slot lies cyclically after it
+    for (size_t i = (hole + 1) & mask; slots[i].food != emptySlot; i = (i + 1) & mask) {
+        size_t home = slots[i].hash & mask;
+        if (((i - home) & mask) >= ((i - hole) & mask)) {
+            slots[hole] = slots[i];
+            hole = i;
+        }
+    }
+    slots[hole] = Slot();
+    --count;
+}
@@ -0,0 +1,40 @@
+#ifndef NAMEINDEX_H
+#define NAMEINDEX_H
+
+#include <bits/stdc++.h>
+#include "symbols.h"
+using namespace std;
+
+using FoodId = uint32_t;
+
+// Open-addressing (linear probing) map from food name to food id. Names
+// compare case-insensitively, so "Banana" and "banana" are the same food.
+// Each slot keeps the name's hash and symbol, so probes rarely touch text.
+class NameIndex {
+public:
+    void clear();
+    void reserve(size_t count);
+    FoodId find(string_view name) const;
+    // False, leaving the index unchanged, when the name is already taken
+    bool insert(Symbol name, FoodId id);
+    void erase(string_view name);
+    size_t size() const { return count; }
+
+    static bool sameName(string_view a, string_view b);
+
+private:
+    static const FoodId emptySlot = numeric_limits<FoodId>::max();
+    struct Slot {
+        uint32_t hash;
+        Symbol name;
+        FoodId food = emptySlot;
+    };
+    vector<Slot> slots;
+    size_t count = 0;
+
+    static uint32_t hashName(string_view name);
+    size_t findSlot(string_view name, uint32_t hash) const;
+    void grow(size_t capacity);
+};
+
+#endif // NAMEINDEX_H
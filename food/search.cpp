@@ -0,0 +1,263 @@
+#include "search.h"
+#include "food.h"
+#include "../io/lines.h"
+
+// Relevance of one query word against one term, by where the term occurs
+static const int exactName = 100;
+static const int exactKeyword = 70;
+static const int prefixName = 60;
+static const int prefixKeyword = 40;
+static const int typoName = 45;
+static const int typoKeyword = 30;
+static const int perEdit = 10;
+// A short prefix can match a large part of the dictionary; only this many
+// completions, in text order, are scored
+static const size_t maxCompletions = 64;
+
+static string normalize(string_view text) {
+    string result(text);
+    for (char& c : result) {
+        c = tolower(static_cast<unsigned char>(c));
+    }
+    return result;
+}
+
+// Typos allowed in a query word; short words must match exactly or by prefix
+static int maxEdits(size_t length) {
+    return length <= 3 ? 0 : length <= 7 ? 1 : 2;
+}
+
+// Distinct trigrams of "^text$", so word starts and ends count too
+static vector<uint32_t> trigramsOf(const string& text) {
+    string padded = "^" + text + "$";
+    vector<uint32_t> grams;
+    for (size_t i = 0; i + 3 <= padded.size(); ++i) {
+        grams.push_back(static_cast<uint8_t>(padded[i]) << 16 | static_cast<uint8_t>(padded[i + 1]) << 8 |
+                        static_cast<uint8_t>(padded[i + 2]));
+    }
+    sort(grams.begin(), grams.end());
+    grams.erase(unique(grams.begin(), grams.end()), grams.end());
+    return grams;
+}
+
+// Trigram lists are split by term length, so typo lookups only visit
+// terms short or long enough to be within reach
+static uint32_t lengthKey(uint32_t gram, size_t length) {
+    return gram | static_cast<uint32_t>(min<size_t>(length, 255)) << 24;
+}
+
+// Levenshtein distance, giving up with limit + 1 as soon as it must exceed limit
+static int boundedDistance(string_view a, string_view b, int limit) {
+    if (abs(static_cast<int>(a.size()) - static_cast<int>(b.size())) > limit) {
+        return limit + 1;
+    }
+
+    // Rows live on the stack for ordinary words
+    int rows[2][64];
+    vector<int> heapRows;
+    int* previous = rows[0];
+    int* current = rows[1];
+    if (b.size() >= 64) {
+        heapRows.resize(2 * (b.size() + 1));
+        previous = heapRows.data();
+        current = previous + b.size() + 1;
+    }
+    iota(previous, previous + b.size() + 1, 0);
+    for (size_t i = 1; i <= a.size(); ++i) {
+        current[0] = i;
+        int rowMin = current[0];
+        for (size_t j = 1; j <= b.size(); ++j) {
+            int substitute = previous[j - 1] + (a[i - 1] != b[j - 1]);
+            current[j] = min({previous[j] + 1, current[j - 1] + 1, substitute});
+            rowMin = min(rowMin, current[j]);
+        }
+        if (rowMin > limit) {
+            return limit + 1;
+        }
+        swap(previous, current);
+    }
+    return previous[b.size()];
+}
+
+void FoodSearchIndex::clear() {
+    indexedFoods = 0;
+    terms.clear();
+    termIds.clear();
+    sortedTerms.clear();
+    newTerms.clear();
+    trigramIndex.clear();
+}
+
+void FoodSearchIndex::add(FoodId id, const Food& food) {
+    string_view name = food.nameText();
+    addTerm(name, id, true);
+    // Multi-word names such as "peanut_butter" are also found by each word
+    if (name.find_first_of("_-") != string_view::npos) {
+        FieldScanner words(name, '_');
+        string_view word;
+        while (words.next(word)) {
+            FieldScanner parts(word, '-');
+            string_view part;
+            while (parts.next(part)) {
+                if (!part.empty()) addTerm(part, id, true);
+            }
+        }
+    }
+    for (Symbol keyword : food.keywords) {
+        addTerm(symbols().text(keyword), id, false);
+    }
+    indexedFoods = max<size_t>(indexedFoods, id + 1);
+}
+
+void FoodSearchIndex::addTerm(string_view text, FoodId id, bool inName) {
+    string key = normalize(text);
+    auto it = termIds.find(key);
+    uint32_t term;
+    if (it != termIds.end()) {
+        term = it->second;
+    } else {
+        term = terms.size();
+        for (uint32_t gram : trigramsOf(key)) {
+            trigramIndex[lengthKey(gram, key.size())].push_back(term);
+        }
+        termIds.emplace(key, term);
+        terms.push_back({move(key), {}});
+        newTerms.push_back(term);
+    }
+
+    vector<Posting>& postings = terms[term].postings;
+    if (!postings.empty() && postings.back().food == id) {
+        postings.back().inName |= inName;
+    } else {
+        postings.push_back({id, inName});
+    }
+}
+
+void FoodSearchIndex::prefixRange(const string& prefix, size_t& first, size_t& last) {
+    auto byText = [&](uint32_t term, const string& text) { return terms[term].text < text; };
+    first = lower_bound(sortedTerms.begin(), sortedTerms.end(), prefix, byText) - sortedTerms.begin();
+    last = first;
+    while (last < sortedTerms.size() && last - first < maxCompletions &&
+           terms[sortedTerms[last]].text.compare(0, prefix.size(), prefix) == 0) {
+        ++last;
+    }
+}
+
+void FoodSearchIndex::sortNewTerms() {
+    if (newTerms.empty()) return;
+    auto byText = [&](uint32_t a, uint32_t b) { return terms[a].text < terms[b].text; };
+    sort(newTerms.begin(), newTerms.end(), byText);
+    if (newTerms.size() < mergeThreshold) {
+        for (uint32_t term : newTerms) {
+            sortedTerms.insert(lower_bound(sortedTerms.begin(), sortedTerms.end(), term, byText), term);
+        }
+    } else {
+        size_t middle = sortedTerms.size();
+        sortedTerms.insert(sortedTerms.end(), newTerms.begin(), newTerms.end());
+        inplace_merge(sortedTerms.begin(), sortedTerms.begin() + middle, sortedTerms.end(), byText);
+    }
+    newTerms.clear();
+}
+
+void FoodSearchIndex::scoreTerm(uint32_t term, int nameScore, int keywordScore, vector<FoodId>& touched) {
+    for (const Posting& posting : terms[term].postings) {
+        int& best = wordScore[posting.food];
+        if (best == 0) {
+            touched.push_back(posting.food);
+        }
+        best = max(best, posting.inName ? nameScore : keywordScore);
+    }
+}
+
+vector<FoodMatch> FoodSearchIndex::search(string_view query, size_t limit, const function<bool(FoodId)>& live) {
+    sortNewTerms();
+    totalScore.resize(indexedFoods);
+    wordScore.resize(indexedFoods);
+    sharedTrigrams.resize(terms.size());
+
+    // Each word adds its best score per food; foods matching more words rank higher
+    vector<FoodId> matched;
+    vector<FoodId> touched;
+    FieldScanner words(query, ' ');
+    string_view text;
+    while (words.next(text)) {
+        string word = normalize(text);
+        touched.clear();
+
+        size_t first, last;
+        prefixRange(word, first, last);
+        for (size_t i = first; i < last; ++i) {
+            // Completions lose a point per extra character, so closer ones rank first
+            int extra = min<int>(terms[sortedTerms[i]].text.size() - word.size(), 20);
+            if (extra == 0) {
+                scoreTerm(sortedTerms[i], exactName, exactKeyword, touched);
+            } else {
+                scoreTerm(sortedTerms[i], prefixName - extra, prefixKeyword - extra, touched);
+            }
+        }
+
+        // Typo candidates share enough trigrams to be within the edit limit;
+        // one edit breaks at most three of them
+        int edits = maxEdits(word.size());
+        if (edits > 0) {
+            vector<uint32_t> grams = trigramsOf(word);
+            int needed = max(1, static_cast<int>(grams.size()) - 3 * edits);
+            vector<uint32_t> candidates;
+            size_t shortest = word.size() > static_cast<size_t>(edits) ? word.size() - edits : 1;
+            for (size_t length = shortest; length <= word.size() + edits; ++length) {
+                for (uint32_t gram : grams) {
+                    auto it = trigramIndex.find(lengthKey(gram, length));
+                    if (it == trigramIndex.end()) continue;
+                    for (uint32_t term : it->second) {
+                        if (sharedTrigrams[term]++ == 0) {
+                            candidates.push_back(term);
+                        }
+                    }
+                }
+            }
+            for (uint32_t term : candidates) {
+                const string& candidate = terms[term].text;
+                // Prefix matches were already scored above
+                if (sharedTrigrams[term] >= needed && candidate.compare(0, word.size(), word) != 0) {
+                    int distance = boundedDistance(word, candidate, edits);
+                    if (distance <= edits) {
+                        scoreTerm(term, typoName - perEdit * distance, typoKeyword - perEdit * distance, touched);
+                    }
+                }
+                sharedTrigrams[term] = 0;
+            }
+        }
+
+        for (FoodId food : touched) {
+            if (totalScore[food] == 0) {
+                matched.push_back(food);
+            }
+            totalScore[food] += wordScore[food];
+            wordScore[food] = 0;
+        }
+    }
+
+    // Keep the best `limit` foods in a heap whose top is the weakest kept
+    auto better = [](const FoodMatch& a, const FoodMatch& b) {
+        return a.score > b.score || (a.score == b.score && a.food < b.food);
+    };
+    priority_queue<FoodMatch, vector<FoodMatch>, decltype(better)> heap(better);
+    for (FoodId food : matched) {
+        FoodMatch match{food, totalScore[food]};
+        totalScore[food] = 0;
+        // Most foods lose to the heap top, so the live check comes last
+        if (heap.size() < limit) {
+            if (live(food)) heap.push(match);
+        } else if (limit > 0 && better(match, heap.top()) && live(food)) {
+            heap.pop();
+            heap.push(match);
+        }
+    }
+
+    vector<FoodMatch> results(heap.size());
+    for (size_t i = results.size(); i-- > 0;) {
+        results[i] = heap.top();
+        heap.pop();
+    }
+    return results;
+}
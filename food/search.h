@@ -0,0 +1,61 @@
+#ifndef SEARCH_H
+#define SEARCH_H
+
+#include <bits/stdc++.h>
+#include "symbols.h"
+using namespace std;
+
+using FoodId = uint32_t;
+struct Food;
+
+struct FoodMatch {
+    FoodId food;
+    int score;
+};
+
+// Ranked search over food names and keywords. Query words match whole
+// terms, term prefixes, or terms within a small edit distance, compared
+// case-insensitively. Foods are added by id and never removed; callers
+// skip removed foods through the filter passed to search().
+class FoodSearchIndex {
+public:
+    void clear();
+    void add(FoodId id, const Food& food);
+    size_t foodCount() const { return indexedFoods; }
+    vector<FoodMatch> search(string_view query, size_t limit, const function<bool(FoodId)>& live);
+
+private:
+    struct Posting {
+        FoodId food;
+        bool inName;
+    };
+    struct Term {
+        string text;
+        vector<Posting> postings;
+    };
+
+    size_t indexedFoods = 0;
+    vector<Term> terms;
+    unordered_map<string, uint32_t> termIds;
+    // Term ids in text order, for prefix ranges. Terms added since the last
+    // search wait in newTerms and are merged in by the next one.
+    vector<uint32_t> sortedTerms;
+    vector<uint32_t> newTerms;
+    // Below this many new terms each is inserted at its place; more, as
+    // after a bulk load, are sorted and merged in one pass
+    static const size_t mergeThreshold = 64;
+    // Padded trigram and term length -> terms, for typo candidates
+    unordered_map<uint32_t, vector<uint32_t>> trigramIndex;
+
+    // Per-query scratch, sized to the food and term counts
+    vector<int> totalScore;
+    vector<int> wordScore;
+    vector<uint16_t> sharedTrigrams;
+
+    void addTerm(string_view text, FoodId id, bool inName);
+    void scoreTerm(uint32_t term, int nameScore, int keywordScore, vector<FoodId>& touched);
+    void prefixRange(const string& prefix, size_t& first, size_t& last);
+    void sortNewTerms();
+};
+
+#endif // SEARCH_H
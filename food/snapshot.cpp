@@ -0,0 +1,264 @@
+#include "snapshot.h"
+#include "food.h"
+#include "../io/files.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static const char snapshotMagic[8] = {'Y', 'A', 'D', 'A', 'F', 'D', 'B', '\0'};
+
+FileStamp FileStamp::of(const string& filename) {
+    FileStamp stamp;
+    struct stat info;
+    if (stat(filename.c_str(), &info) == 0) {
+        stamp.size = info.st_size;
+        stamp.mtime = static_cast<int64_t>(info.st_mtim.tv_sec) * 1000000000 + info.st_mtim.tv_nsec;
+    }
+    return stamp;
+}
+
+template <typename T>
+static void appendArray(string& out, const vector<T>& values) {
+    out.append(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(T));
+}
+
+FoodSnapshot::~FoodSnapshot() {
+    close();
+}
+
+bool FoodSnapshot::write(const string& filename, const vector<Food>& foodList,
+                         const FileStamp& basicStamp, const FileStamp& compositeStamp) {
+    string heap;
+    auto addString = [&heap](string_view text) {
+        uint32_t offset = heap.size();
+        heap += text;
+        return offset;
+    };
+
+    // Removed foods are left out, so live foods are renumbered densely and
+    // the keyword index is rebuilt against the new numbers
+    map<string_view, vector<uint32_t>> keywordFoods;
+    vector<uint32_t> renumbered(foodList.size());
+    uint32_t written = 0;
+    for (size_t id = 0; id < foodList.size(); ++id) {
+        const Food& food = foodList[id];
+        if (food.removed) continue;
+        renumbered[id] = written;
+        for (Symbol keyword : food.keywords) {
+            vector<uint32_t>& list = keywordFoods[symbols().text(keyword)];
+            if (list.empty() || list.back() != written) {
+                list.push_back(written);
+            }
+        }
+        ++written;
+    }
+
+    // Keywords are stored in sorted order; foods refer to them by position
+    unordered_map<string_view, uint32_t> keywordIds;
+    vector<KeywordRecord> keywordRecords;
+    vector<uint32_t> postingValues;
+    for (const auto& entry : keywordFoods) {
+        keywordIds[entry.first] = keywordRecords.size();
+        keywordRecords.push_back({addString(entry.first), static_cast<uint32_t>(entry.first.size()),
+                                  static_cast<uint32_t>(postingValues.size()),
+                                  static_cast<uint32_t>(entry.second.size())});
+        postingValues.insert(postingValues.end(), entry.second.begin(), entry.second.end());
+    }
+
+    vector<FoodRecord> foodRecords;
+    vector<uint32_t> foodKeywordValues;
+    vector<IngredientRecord> ingredientRecords;
+    foodRecords.reserve(written);
+    for (const auto& food : foodList) {
+        if (food.removed) continue;
+        FoodRecord record;
+        record.nameOffset = addString(food.nameText());
+        record.nameLength = food.nameText().size();
+        record.calories = food.calories;
+        record.flags = food.isComposite ? compositeFlag : 0;
+        record.keywordStart = foodKeywordValues.size();
+        record.keywordCount = food.keywords.size();
+        for (Symbol keyword : food.keywords) {
+            foodKeywordValues.push_back(keywordIds.at(symbols().text(keyword)));
+        }
+        record.ingredientStart = ingredientRecords.size();
+        record.ingredientCount = food.ingredients.size();
+        for (const auto& ingredient : food.ingredients) {
+            ingredientRecords.push_back({renumbered[ingredient.food], 0, ingredient.quantity});
+        }
+        foodRecords.push_back(record);
+    }
+
+    Header header = {};
+    memcpy(header.magic, snapshotMagic, sizeof(header.magic));
+    header.version = version;
+    header.foodCount = foodRecords.size();
+    header.foodKeywordCount = foodKeywordValues.size();
+    header.ingredientCount = ingredientRecords.size();
+    header.keywordCount = keywordRecords.size();
+    header.postingCount = postingValues.size();
+    header.stringHeapSize = heap.size();
+    header.basicSize = basicStamp.size;
+    header.basicMtime = basicStamp.mtime;
+    header.compositeSize = compositeStamp.size;
+    header.compositeMtime = compositeStamp.mtime;
+
+    string body;
+    appendArray(body, foodRecords);
+    appendArray(body, ingredientRecords);
+    appendArray(body, foodKeywordValues);
+    appendArray(body, keywordRecords);
+    appendArray(body, postingValues);
+    body += heap;
+    header.checksum = checksumOf(body);
+
+    string contents(reinterpret_cast<const char*>(&header), sizeof(header));
+    contents += body;
+    return writeFileAtomically(filename, contents);
+}
+
+bool FoodSnapshot::open(const string& filename, const FileStamp& basicStamp, const FileStamp& compositeStamp) {
+    close();
+
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size < static_cast<off_t>(sizeof(Header))) {
+        ::close(fd);
+        return false;
+    }
+
+    void* mapped = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (mapped == MAP_FAILED) return false;
+
+    data = static_cast<const char*>(mapped);
+    length = info.st_size;
+    header = reinterpret_cast<const Header*>(data);
+
+    FileStamp recordedBasic{header->basicSize, header->basicMtime};
+    FileStamp recordedComposite{header->compositeSize, header->compositeMtime};
+    if (memcmp(header->magic, snapshotMagic, sizeof(snapshotMagic)) != 0 || header->version != version ||
+        !(recordedBasic == basicStamp) || !(recordedComposite == compositeStamp)) {
+        close();
+        return false;
+    }
+
+    uint64_t expected = sizeof(Header) +
+                        uint64_t(header->foodCount) * sizeof(FoodRecord) +
+                        uint64_t(header->ingredientCount) * sizeof(IngredientRecord) +
+                        uint64_t(header->foodKeywordCount) * sizeof(uint32_t) +
+                        uint64_t(header->keywordCount) * sizeof(KeywordRecord) +
+                        uint64_t(header->postingCount) * sizeof(uint32_t) +
+                        header->stringHeapSize;
+    if (expected != length) {
+        close();
+        return false;
+    }
+
+    const char* cursor = data + sizeof(Header);
+    foods = reinterpret_cast<const FoodRecord*>(cursor);
+    cursor += header->foodCount * sizeof(FoodRecord);
+    ingredients = reinterpret_cast<const IngredientRecord*>(cursor);
+    cursor += header->ingredientCount * sizeof(IngredientRecord);
+    foodKeywords = reinterpret_cast<const uint32_t*>(cursor);
+    cursor += header->foodKeywordCount * sizeof(uint32_t);
+    keywords = reinterpret_cast<const KeywordRecord*>(cursor);
+    cursor += header->keywordCount * sizeof(KeywordRecord);
+    postingData = reinterpret_cast<const uint32_t*>(cursor);
+    cursor += header->postingCount * sizeof(uint32_t);
+    strings = cursor;
+    return true;
+}
+
+void FoodSnapshot::close() {
+    if (data) {
+        munmap(const_cast<char*>(data), length);
+    }
+    data = nullptr;
+    length = 0;
+    header = nullptr;
+}
+
+bool FoodSnapshot::verify() const {
+    if (!header || checksumOf(string_view(data + sizeof(Header), length - sizeof(Header))) != header->checksum) {
+        return false;
+    }
+    // Every offset, range and index the accessors follow must stay inside
+    // its section
+    auto inside = [](uint64_t start, uint64_t count, uint64_t size) { return start + count <= size; };
+    for (uint32_t i = 0; i < header->foodCount; ++i) {
+        const FoodRecord& food = foods[i];
+        if (!inside(food.nameOffset, food.nameLength, header->stringHeapSize) ||
+            !inside(food.keywordStart, food.keywordCount, header->foodKeywordCount) ||
+            !inside(food.ingredientStart, food.ingredientCount, header->ingredientCount)) {
+            return false;
+        }
+    }
+    for (uint32_t i = 0; i < header->ingredientCount; ++i) {
+        if (ingredients[i].food >= header->foodCount) return false;
+    }
+    for (uint32_t i = 0; i < header->foodKeywordCount; ++i) {
+        if (foodKeywords[i] >= header->keywordCount) return false;
+    }
+    for (uint32_t k = 0; k < header->keywordCount; ++k) {
+        const KeywordRecord& keyword = keywords[k];
+        if (!inside(keyword.textOffset, keyword.textLength, header->stringHeapSize) ||
+            !inside(keyword.postingStart, keyword.postingCount, header->postingCount)) {
+            return false;
+        }
+    }
+    for (uint32_t i = 0; i < header->postingCount; ++i) {
+        if (postingData[i] >= header->foodCount) return false;
+    }
+    return true;
+}
+
+uint32_t FoodSnapshot::foodCount() const {
+    return header ? header->foodCount : 0;
+}
+
+string_view FoodSnapshot::foodName(uint32_t food) const {
+    return string_view(strings + foods[food].nameOffset, foods[food].nameLength);
+}
+
+int FoodSnapshot::foodCalories(uint32_t food) const {
+    return foods[food].calories;
+}
+
+bool FoodSnapshot::foodIsComposite(uint32_t food) const {
+    return foods[food].flags & compositeFlag;
+}
+
+uint32_t FoodSnapshot::foodKeywordCount(uint32_t food) const {
+    return foods[food].keywordCount;
+}
+
+uint32_t FoodSnapshot::foodKeywordIndex(uint32_t food, uint32_t k) const {
+    return foodKeywords[foods[food].keywordStart + k];
+}
+
+uint32_t FoodSnapshot::foodIngredientCount(uint32_t food) const {
+    return foods[food].ingredientCount;
+}
+
+uint32_t FoodSnapshot::foodIngredient(uint32_t food, uint32_t i, double& quantity) const {
+    const IngredientRecord& record = ingredients[foods[food].ingredientStart + i];
+    quantity = record.quantity;
+    return record.food;
+}
+
+uint32_t FoodSnapshot::keywordCount() const {
+    return header ? header->keywordCount : 0;
+}
+
+string_view FoodSnapshot::keyword(uint32_t k) const {
+    return string_view(strings + keywords[k].textOffset, keywords[k].textLength);
+}
+
+const uint32_t* FoodSnapshot::postings(uint32_t k, uint32_t& count) const {
+    count = keywords[k].postingCount;
+    return postingData + keywords[k].postingStart;
+}
@@ -0,0 +1,110 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <bits/stdc++.h>
+using namespace std;
+
+struct Food;
+
+// Size and modification time of a text database file, recorded in the
+// snapshot so a changed or missing source file marks the snapshot stale
+struct FileStamp {
+    int64_t size = -1;
+    int64_t mtime = -1;
+
+    static FileStamp of(const string& filename);
+    bool operator==(const FileStamp& other) const { return size == other.size && mtime == other.mtime; }
+};
+
+// Versioned binary image of the food database. After a fixed header come
+// fixed-width food records, the recipe edges of composites, the per-food
+// keyword lists, the keyword table with its posting lists, and finally a
+// heap with all of their text.
+// The file is mapped read-only and every accessor reads it in place. The
+// checksum covers everything after the header; verify() checks it along
+// with every position the accessors follow, so it reads the whole file.
+// FoodList copies the foods out afterwards: the snapshot saves parsing,
+// not the copy.
+class FoodSnapshot {
+public:
+    static const uint32_t version = 4;
+
+    FoodSnapshot() = default;
+    FoodSnapshot(const FoodSnapshot&) = delete;
+    FoodSnapshot& operator=(const FoodSnapshot&) = delete;
+    ~FoodSnapshot();
+
+    static bool write(const string& filename, const vector<Food>& foods,
+                      const FileStamp& basicStamp, const FileStamp& compositeStamp);
+    bool open(const string& filename, const FileStamp& basicStamp, const FileStamp& compositeStamp);
+    void close();
+    bool verify() const;
+
+    uint32_t foodCount() const;
+    string_view foodName(uint32_t food) const;
+    int foodCalories(uint32_t food) const;
+    bool foodIsComposite(uint32_t food) const;
+    uint32_t foodKeywordCount(uint32_t food) const;
+    uint32_t foodKeywordIndex(uint32_t food, uint32_t k) const;
+    uint32_t foodIngredientCount(uint32_t food) const;
+    uint32_t foodIngredient(uint32_t food, uint32_t i, double& quantity) const;
+
+    uint32_t keywordCount() const;
+    string_view keyword(uint32_t k) const;
+    const uint32_t* postings(uint32_t k, uint32_t& count) const;
+
+private:
+    struct Header {
+        char magic[8];
+        uint32_t version;
+        uint32_t foodCount;
+        uint32_t foodKeywordCount;
+        uint32_t ingredientCount;
+        uint32_t keywordCount;
+        uint32_t postingCount;
+        uint32_t stringHeapSize;
+        int64_t basicSize;
+        int64_t basicMtime;
+        int64_t compositeSize;
+        int64_t compositeMtime;
+        uint64_t checksum;
+    };
+
+    struct FoodRecord {
+        uint32_t nameOffset;
+        uint32_t nameLength;
+        int32_t calories;
+        uint32_t flags;
+        uint32_t keywordStart;
+        uint32_t keywordCount;
+        uint32_t ingredientStart;
+        uint32_t ingredientCount;
+    };
+
+    struct IngredientRecord {
+        uint32_t food;
+        uint32_t reserved;
+        double quantity;
+    };
+
+    struct KeywordRecord {
+        uint32_t textOffset;
+        uint32_t textLength;
+        uint32_t postingStart;
+        uint32_t postingCount;
+    };
+
+    static const uint32_t compositeFlag = 1;
+
+    const char* data = nullptr;
+    size_t length = 0;
+    const Header* header = nullptr;
+    const FoodRecord* foods = nullptr;
+    const uint32_t* foodKeywords = nullptr;
+    const IngredientRecord* ingredients = nullptr;
+    const KeywordRecord* keywords = nullptr;
+    const uint32_t* postingData = nullptr;
+    const char* strings = nullptr;
+};
+
+#endif // SNAPSHOT_H
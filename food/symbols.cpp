@@ -0,0 +1,38 @@
+#include "symbols.h"
+
+Symbol SymbolTable::intern(string_view text) {
+    lock_guard<mutex> guard(lock);
+    auto it = ids.find(text);
+    if (it != ids.end()) {
+        return it->second;
+    }
+
+    Symbol symbol = count.load(memory_order_relaxed);
+    if ((symbol >> blockBits) >= maxBlocks) {
+        throw length_error("symbol table is full");
+    }
+    unique_ptr<string_view[]>& block = blocks[symbol >> blockBits];
+    if (!block) {
+        block.reset(new string_view[blockMask + 1]);
+    }
+    string_view stored = texts.copy(text);
+    block[symbol & blockMask] = stored;
+    ids.emplace(stored, symbol);
+    count.store(symbol + 1, memory_order_release);
+    return symbol;
+}
+
+bool SymbolTable::find(string_view text, Symbol& symbol) const {
+    lock_guard<mutex> guard(lock);
+    auto it = ids.find(text);
+    if (it == ids.end()) {
+        return false;
+    }
+    symbol = it->second;
+    return true;
+}
+
+SymbolTable& symbols() {
+    static SymbolTable table;
+    return table;
+}
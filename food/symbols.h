@@ -0,0 +1,37 @@
+#ifndef SYMBOLS_H
+#define SYMBOLS_H
+
+#include <bits/stdc++.h>
+#include "../arena/arena.h"
+using namespace std;
+
+// 32-bit id of an interned string; equal strings always get the same id
+using Symbol = uint32_t;
+
+// Process-wide interning table for food names and keywords. Each distinct
+// string is stored once in an arena and never moves, so text() views stay
+// valid. intern() and find() may be called from several threads at once;
+// text() takes no lock because blocks are never reallocated once published.
+class SymbolTable {
+public:
+    Symbol intern(string_view text);
+    bool find(string_view text, Symbol& symbol) const;
+    string_view text(Symbol symbol) const { return blocks[symbol >> blockBits][symbol & blockMask]; }
+    size_t size() const { return count.load(memory_order_acquire); }
+
+private:
+    // Room for 2^28 symbols in blocks of 16384 strings
+    static const int blockBits = 14;
+    static const Symbol blockMask = (1u << blockBits) - 1;
+    static const size_t maxBlocks = 1 << 14;
+
+    mutable mutex lock;
+    atomic<size_t> count{0};
+    vector<unique_ptr<string_view[]>> blocks = vector<unique_ptr<string_view[]>>(maxBlocks);
+    unordered_map<string_view, Symbol> ids;
+    Arena texts;
+};
+
+SymbolTable& symbols();
+
+#endif // SYMBOLS_H
@@ -0,0 +1,57 @@
+#include "files.h"
+#include <filesystem>
+#include <fcntl.h>
+#include <unistd.h>
+
+bool writeFileAtomically(const string& filename, string_view contents) {
+    string tempFile = filename + ".tmp";
+    int fd = ::open(tempFile.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        cerr << "Error opening file for writing: " << tempFile << endl;
+        return false;
+    }
+
+    const char* data = contents.data();
+    size_t left = contents.size();
+    while (left > 0) {
+        ssize_t written = ::write(fd, data, left);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            cerr << "Error writing file: " << tempFile << ": " << strerror(errno) << endl;
+            ::close(fd);
+            return false;
+        }
+        data += written;
+        left -= written;
+    }
+    bool synced = fsync(fd) == 0;
+    if (::close(fd) != 0 || !synced) {
+        cerr << "Error writing file: " << tempFile << endl;
+        return false;
+    }
+
+    if (rename(tempFile.c_str(), filename.c_str()) != 0) {
+        cerr << "Error replacing file: " << filename << endl;
+        return false;
+    }
+
+    // The new name is only durable once the directory holding it is synced
+    string directory = filesystem::path(filename).parent_path().string();
+    int dirFd = ::open(directory.empty() ? "." : directory.c_str(), O_RDONLY | O_DIRECTORY);
+    bool dirSynced = dirFd >= 0 && fsync(dirFd) == 0;
+    if (dirFd >= 0) ::close(dirFd);
+    if (!dirSynced) {
+        cerr << "Error syncing directory of: " << filename << endl;
+        return false;
+    }
+    return true;
+}
+
+uint64_t checksumOf(string_view bytes) {
+    uint64_t hash = 14695981039346656037ull;
+    for (unsigned char byte : bytes) {
+        hash ^= byte;
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
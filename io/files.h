@@ -0,0 +1,15 @@
+#ifndef FILES_H
+#define FILES_H
+
+#include <bits/stdc++.h>
+using namespace std;
+
+// Writes contents beside filename, fsyncs it, renames it into place and
+// syncs the directory, so readers and crashes only ever see the old file or
+// the complete new one
+bool writeFileAtomically(const string& filename, string_view contents);
+
+// FNV-1a over the bytes, for spotting damaged binary files
+uint64_t checksumOf(string_view bytes);
+
+#endif // FILES_H
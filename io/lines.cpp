@@ -0,0 +1,165 @@
+#include "lines.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+void reportErrors(const string& filename, const vector<ParseError>& errors) {
+    // One write, so reports from loaders running side by side do not interleave
+    string report;
+    for (const auto& error : errors) {
+        report += filename + ":" + to_string(error.line) + ": " + error.message + "\n";
+    }
+    cerr << report;
+}
+
+void BufferedWriter::flush() {
+    if (buffer.empty()) return;
+    out.write(buffer.data(), buffer.size());
+    buffer.clear();
+}
+
+MappedFile::~MappedFile() {
+    if (address) {
+        munmap(address, length);
+    }
+}
+
+bool MappedFile::open(const string& filename) {
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+
+    struct stat info;
+    bool ok = fstat(fd, &info) == 0;
+    if (ok && info.st_size > 0) {
+        void* mapped = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapped == MAP_FAILED) {
+            ok = false;
+        } else {
+            address = mapped;
+            length = info.st_size;
+            madvise(address, length, MADV_SEQUENTIAL);
+        }
+    }
+    ::close(fd);
+    return ok;
+}
+
+vector<string_view> lineChunks(string_view text, size_t minChunkBytes) {
+    size_t workers = max(1u, thread::hardware_concurrency());
+    size_t parts = max<size_t>(1, min(workers, text.size() / max<size_t>(1, minChunkBytes)));
+    size_t target = text.size() / parts;
+
+    vector<string_view> chunks;
+    size_t begin = 0;
+    for (size_t part = 1; part < parts && begin < text.size(); ++part) {
+        // Move each cut forward to just past the next newline
+        size_t cut = text.find('\n', max(begin, part * target));
+        if (cut == string_view::npos) break;
+        chunks.push_back(text.substr(begin, cut + 1 - begin));
+        begin = cut + 1;
+    }
+    if (begin < text.size() || chunks.empty()) {
+        chunks.push_back(text.substr(begin));
+    }
+    return chunks;
+}
+
+LineReader::~LineReader() {
+    if (fd >= 0) {
+        ::close(fd);
+    }
+}
+
+bool LineReader::open(const string& filename) {
+    fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    return true;
+}
+
+bool LineReader::fill() {
+    // Keep the unfinished line, moving it to the front; grow the buffer
+    // only when a single line fills all of it
+    if (begin > 0) {
+        memmove(buffer.data(), buffer.data() + begin, end - begin);
+        end -= begin;
+        begin = 0;
+    }
+    if (end == buffer.size()) {
+        buffer.resize(buffer.size() * 2);
+    }
+
+    while (true) {
+        ssize_t count = ::read(fd, buffer.data() + end, buffer.size() - end);
+        if (count < 0 && errno == EINTR) continue;
+        if (count <= 0) {
+            atEof = true;
+            return false;
+        }
+        end += count;
+        return true;
+    }
+}
+
+bool LineReader::next(string_view& line) {
+    if (fd < 0) return false;
+
+    size_t scanned = begin;
+    while (true) {
+        const char* start = buffer.data() + begin;
+        const char* newline = static_cast<const char*>(memchr(buffer.data() + scanned, '\n', end - scanned));
+        if (newline) {
+            line = string_view(start, newline - start);
+            begin = newline - buffer.data() + 1;
+            terminated = true;
+            ++lines;
+            return true;
+        }
+
+        if (atEof) {
+            if (begin == end) return false;
+            line = string_view(start, end - begin);
+            begin = end;
+            terminated = false;
+            ++lines;
+            return true;
+        }
+
+        scanned = end - begin;
+        fill();
+        scanned += begin;
+    }
+}
+
+bool FieldScanner::next(string_view& field) {
+    if (separator == ' ') {
+        size_t start = 0;
+        while (start < text.size() && isspace(static_cast<unsigned char>(text[start]))) ++start;
+        if (start == text.size()) {
+            text = string_view();
+            return false;
+        }
+        size_t stop = start;
+        while (stop < text.size() && !isspace(static_cast<unsigned char>(text[stop]))) ++stop;
+        field = text.substr(start, stop - start);
+        text.remove_prefix(stop);
+        return true;
+    }
+
+    if (done) return false;
+    size_t stop = text.find(separator);
+    if (stop == string_view::npos) {
+        field = text;
+        text = string_view();
+        done = true;
+    } else {
+        field = text.substr(0, stop);
+        text.remove_prefix(stop + 1);
+    }
+    return true;
+}
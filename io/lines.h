@@ -0,0 +1,149 @@
+#ifndef LINES_H
+#define LINES_H
+
+#include <bits/stdc++.h>
+using namespace std;
+
+// A line that could not be parsed, reported instead of throwing
+struct ParseError {
+    long line;
+    string message;
+};
+
+void reportErrors(const string& filename, const vector<ParseError>& errors);
+
+// Reads a file through one large buffer and hands out its lines as views
+// into that buffer, valid until the next call to next()
+class LineReader {
+public:
+    explicit LineReader(size_t bufferSize = 1 << 20) : buffer(bufferSize) {}
+    LineReader(const LineReader&) = delete;
+    LineReader& operator=(const LineReader&) = delete;
+    ~LineReader();
+
+    bool open(const string& filename);
+    bool next(string_view& line);
+    long lineNumber() const { return lines; }
+    // False when the last line handed out had no trailing newline
+    bool lastLineTerminated() const { return terminated; }
+
+private:
+    int fd = -1;
+    vector<char> buffer;
+    size_t begin = 0;
+    size_t end = 0;
+    bool atEof = false;
+    bool terminated = true;
+    long lines = 0;
+    bool fill();
+};
+
+// Collects output in one buffer and hands it to the stream in large blocks,
+// so printing many lines costs a write per block instead of one per line.
+// Whatever is left is written when the writer goes away.
+class BufferedWriter {
+public:
+    explicit BufferedWriter(ostream& out, size_t capacity = 1 << 16) : out(out), capacity(capacity) {
+        buffer.reserve(capacity);
+    }
+    BufferedWriter(const BufferedWriter&) = delete;
+    BufferedWriter& operator=(const BufferedWriter&) = delete;
+    ~BufferedWriter() { flush(); }
+
+    BufferedWriter& operator<<(string_view text) {
+        if (buffer.size() + text.size() > capacity) flush();
+        buffer.append(text);
+        return *this;
+    }
+    BufferedWriter& operator<<(char c) {
+        if (buffer.size() + 1 > capacity) flush();
+        buffer += c;
+        return *this;
+    }
+    template <typename T, typename = enable_if_t<is_integral_v<T>>>
+    BufferedWriter& operator<<(T value) {
+        char digits[24];
+        auto result = to_chars(digits, digits + sizeof(digits), value);
+        return *this << string_view(digits, result.ptr - digits);
+    }
+    void flush();
+
+private:
+    ostream& out;
+    size_t capacity;
+    string buffer;
+};
+
+// Read-only mapping of a whole file, for parsing it in parallel chunks
+class MappedFile {
+public:
+    MappedFile() = default;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    ~MappedFile();
+
+    bool open(const string& filename);
+    string_view text() const { return string_view(static_cast<const char*>(address), length); }
+
+private:
+    void* address = nullptr;
+    size_t length = 0;
+};
+
+// Splits text into byte ranges of whole lines, one per worker thread. Text
+// below minChunkBytes per worker comes back as fewer (or a single) range.
+vector<string_view> lineChunks(string_view text, size_t minChunkBytes = 1 << 20);
+
+// Runs parse(range, result) for every range, the first on the calling
+// thread and the rest on threads of their own; results keep range order
+template <typename Result, typename Parse>
+vector<Result> parseChunks(const vector<string_view>& ranges, Parse parse) {
+    vector<Result> results(ranges.size());
+    vector<future<void>> workers;
+    for (size_t i = 1; i < ranges.size(); ++i) {
+        workers.push_back(async(launch::async, [&, i] { parse(ranges[i], results[i]); }));
+    }
+    if (!ranges.empty()) {
+        parse(ranges[0], results[0]);
+    }
+    for (auto& worker : workers) {
+        worker.get();
+    }
+    return results;
+}
+
+// Calls body(line, lineNumber) for each line of text, numbering from 1,
+// and returns the number of lines
+template <typename Body>
+long forEachLine(string_view text, Body body) {
+    long lineNumber = 0;
+    while (!text.empty()) {
+        size_t stop = text.find('\n');
+        body(text.substr(0, stop), ++lineNumber);
+        text.remove_prefix(stop == string_view::npos ? text.size() : stop + 1);
+    }
+    return lineNumber;
+}
+
+// Splits a line into fields. A space separator splits on runs of
+// whitespace; any other character splits on each occurrence.
+class FieldScanner {
+public:
+    FieldScanner(string_view line, char separator) : text(line), separator(separator) {}
+    bool next(string_view& field);
+    string_view rest() const { return text; }
+
+private:
+    string_view text;
+    char separator;
+    bool done = false;
+};
+
+// Whole-field numeric parsing with std::from_chars; false on any leftover
+template <typename T>
+bool parseNumber(string_view text, T& value) {
+    auto result = from_chars(text.data(), text.data() + text.size(), value);
+    return result.ec == errc() && result.ptr == text.data() + text.size();
+}
+
+#endif // LINES_H
@@ -0,0 +1,56 @@
+#include "log.h"
+
+LogEntry LogColumns::entry(size_t row) const {
+    LogEntry entry;
+    entry.food = foods[row];
+    entry.foodName = foodNames[row];
+    entry.servings = servingValues[row];
+    entry.date = dates[row];
+    entry.calories = calorieValues[row];
+    entry.day = days[row];
+    return entry;
+}
+
+size_t LogColumns::insertionRow(time_t date) const {
+    return upper_bound(dates.begin(), dates.end(), static_cast<int64_t>(date)) - dates.begin();
+}
+
+void LogColumns::dayRows(int firstDay, int lastDay, size_t& first, size_t& last) const {
+    first = lower_bound(days.begin(), days.end(), firstDay) - days.begin();
+    last = upper_bound(days.begin() + first, days.end(), lastDay) - days.begin();
+}
+
+void LogColumns::reserve(size_t rows) {
+    dates.reserve(rows);
+    days.reserve(rows);
+    calorieValues.reserve(rows);
+    servingValues.reserve(rows);
+    foods.reserve(rows);
+    foodNames.reserve(rows);
+}
+
+void LogColumns::append(const LogEntry& entry) {
+    insert(size(), entry);
+}
+
+void LogColumns::insert(size_t row, const LogEntry& entry) {
+    dates.insert(dates.begin() + row, entry.date);
+    days.insert(days.begin() + row, entry.day);
+    calorieValues.insert(calorieValues.begin() + row, entry.calories);
+    servingValues.insert(servingValues.begin() + row, entry.servings);
+    foods.insert(foods.begin() + row, entry.food);
+    foodNames.insert(foodNames.begin() + row, entry.foodName);
+}
+
+void LogColumns::erase(size_t row) {
+    dates.erase(dates.begin() + row);
+    days.erase(days.begin() + row);
+    calorieValues.erase(calorieValues.begin() + row);
+    servingValues.erase(servingValues.begin() + row);
+    foods.erase(foods.begin() + row);
+    foodNames.erase(foodNames.begin() + row);
+}
+
+void LogColumns::release() {
+    *this = LogColumns();
+}
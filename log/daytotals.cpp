@@ -0,0 +1,117 @@
+#include "daytotals.h"
+
+template <typename T>
+static void update(vector<T>& tree, int slot, T delta) {
+    for (size_t i = slot + 1; i < tree.size(); i += i & -i) {
+        tree[i] += delta;
+    }
+}
+
+// Builds a Fenwick tree over values in O(n)
+template <typename T>
+static void build(vector<T>& tree, const vector<T>& values) {
+    tree.assign(values.size() + 1, 0);
+    for (size_t i = 1; i < tree.size(); ++i) {
+        tree[i] += values[i - 1];
+        size_t parent = i + (i & -i);
+        if (parent < tree.size()) {
+            tree[parent] += tree[i];
+        }
+    }
+}
+
+template <typename T>
+T DayTotals::prefix(const vector<T>& tree, int slot) {
+    T total = 0;
+    for (int i = min<int>(slot + 1, tree.size() - 1); i > 0; i -= i & -i) {
+        total += tree[i];
+    }
+    return total;
+}
+
+template <typename T>
+T DayTotals::rangeSum(const vector<T>& tree, int origin, int firstDay, int lastDay) {
+    int last = lastDay - origin;
+    int first = max(firstDay - origin, 0);
+    if (tree.empty() || firstDay > lastDay || last < 0 || first >= static_cast<int>(tree.size()) - 1) {
+        return 0;
+    }
+    return prefix(tree, last) - prefix(tree, first - 1);
+}
+
+void DayTotals::clear() {
+    origin = 0;
+    dailyCalories.clear();
+    dailyEntries.clear();
+    calorieTree.clear();
+    loggedTree.clear();
+}
+
+void DayTotals::cover(int day) {
+    int size = dailyCalories.size();
+    if (size > 0 && day >= origin && day < origin + size) {
+        return;
+    }
+
+    // Grow to at least twice the old span so repeated growth stays O(1) amortized
+    int first = size == 0 ? day : min(origin, day);
+    int end = size == 0 ? day + 1 : max(origin + size, day + 1);
+    int newSize = max(end - first, 2 * size);
+    int newOrigin = day < origin ? end - newSize : first;
+
+    vector<long> calories(newSize);
+    vector<int> entries(newSize);
+    for (int i = 0; i < size; ++i) {
+        calories[origin + i - newOrigin] = dailyCalories[i];
+        entries[origin + i - newOrigin] = dailyEntries[i];
+    }
+    vector<int> logged(newSize);
+    for (int i = 0; i < newSize; ++i) {
+        logged[i] = entries[i] > 0;
+    }
+
+    origin = newOrigin;
+    dailyCalories.swap(calories);
+    dailyEntries.swap(entries);
+    build(calorieTree, dailyCalories);
+    build(loggedTree, logged);
+}
+
+void DayTotals::add(int day, long calories, int entries) {
+    cover(day);
+    int slot = day - origin;
+    bool wasLogged = dailyEntries[slot] > 0;
+    dailyCalories[slot] += calories;
+    dailyEntries[slot] += entries;
+    update(calorieTree, slot, calories);
+    bool isLogged = dailyEntries[slot] > 0;
+    if (wasLogged != isLogged) {
+        update(loggedTree, slot, isLogged ? 1 : -1);
+    }
+}
+
+long DayTotals::caloriesOn(int day) const {
+    int slot = day - origin;
+    return slot >= 0 && slot < static_cast<int>(dailyCalories.size()) ? dailyCalories[slot] : 0;
+}
+
+int DayTotals::entriesOn(int day) const {
+    int slot = day - origin;
+    return slot >= 0 && slot < static_cast<int>(dailyEntries.size()) ? dailyEntries[slot] : 0;
+}
+
+void DayTotals::forEachDay(const function<void(int, long, int)>& visit) const {
+    for (size_t slot = 0; slot < dailyEntries.size(); ++slot) {
+        if (dailyEntries[slot] > 0) {
+            visit(origin + slot, dailyCalories[slot], dailyEntries[slot]);
+        }
+    }
+}
+
+long DayTotals::calories(int firstDay, int lastDay) const {
+    return rangeSum(calorieTree, origin, firstDay, lastDay);
+}
+
+int DayTotals::loggedDays(int firstDay, int lastDay) const {
+    return rangeSum(loggedTree, origin, firstDay, lastDay);
+}
@@ -0,0 +1,36 @@
+#ifndef DAYTOTALS_H
+#define DAYTOTALS_H
+
+#include <bits/stdc++.h>
+using namespace std;
+
+// Calories and entry counts per local day, with Fenwick trees over them so
+// any range of days sums in O(log days). The covered span of days grows
+// (by doubling) to take in whatever days are added.
+class DayTotals {
+public:
+    void clear();
+    void add(int day, long calories, int entries);
+    long caloriesOn(int day) const;
+    int entriesOn(int day) const;
+    // Calls visit(day, calories, entries) for each day with entries, in order
+    void forEachDay(const function<void(int, long, int)>& visit) const;
+    long calories(int firstDay, int lastDay) const;
+    // Days in the range with at least one entry
+    int loggedDays(int firstDay, int lastDay) const;
+
+private:
+    int origin = 0;
+    vector<long> dailyCalories;
+    vector<int> dailyEntries;
+    // 1-based Fenwick trees over dailyCalories and over "has entries" flags
+    vector<long> calorieTree;
+    vector<int> loggedTree;
+    void cover(int day);
+    template <typename T>
+    static T prefix(const vector<T>& tree, int slot);
+    template <typename T>
+    static T rangeSum(const vector<T>& tree, int origin, int firstDay, int lastDay);
+};
+
+#endif // DAYTOTALS_H
@@ -0,0 +1,112 @@
+#include "journal.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include "../io/lines.h"
+
+Journal::~Journal() {
+    close();
+}
+
+bool Journal::open(const string& filename, int existingRecords) {
+    close();
+    lock_guard<mutex> guard(lock);
+    fd = ::open(filename.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+    if (fd < 0) {
+        cerr << "Error opening journal for writing: " << filename << endl;
+        return false;
+    }
+    records = existingRecords;
+    pending = 0;
+    lastSync = chrono::steady_clock::now();
+    return true;
+}
+
+void Journal::close() {
+    sync();
+    lock_guard<mutex> syncing(syncLock);
+    lock_guard<mutex> guard(lock);
+    if (fd >= 0) {
+        ::close(fd);
+        fd = -1;
+    }
+}
+
+void Journal::append(const string& record) {
+    unique_lock<mutex> guard(lock);
+    if (fd < 0) return;
+
+    string line = record + "\n";
+    const char* data = line.data();
+    size_t left = line.size();
+    while (left > 0) {
+        ssize_t written = ::write(fd, data, left);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            cerr << "Error appending to journal: " << strerror(errno) << endl;
+            return;
+        }
+        data += written;
+        left -= written;
+    }
+
+    ++records;
+    ++pending;
+    bool due = pending >= syncBatch || chrono::steady_clock::now() - lastSync >= syncInterval;
+    guard.unlock();
+    if (due && !syncsDeferred) {
+        sync();
+    }
+}
+
+void Journal::sync() {
+    lock_guard<mutex> syncing(syncLock);
+    int syncFd;
+    {
+        lock_guard<mutex> guard(lock);
+        if (fd < 0 || pending == 0) return;
+        syncFd = fd;
+        pending = 0;
+        lastSync = chrono::steady_clock::now();
+    }
+    fdatasync(syncFd);
+}
+
+int Journal::size() const {
+    lock_guard<mutex> guard(lock);
+    return records;
+}
+
+void Journal::truncate() {
+    lock_guard<mutex> guard(lock);
+    if (fd < 0) return;
+    if (ftruncate(fd, 0) != 0) {
+        cerr << "Error truncating journal: " << strerror(errno) << endl;
+        return;
+    }
+    fdatasync(fd);
+    records = 0;
+    pending = 0;
+    lastSync = chrono::steady_clock::now();
+}
+
+void Journal::swap(Journal& other) {
+    scoped_lock guard(syncLock, other.syncLock, lock, other.lock);
+    std::swap(fd, other.fd);
+    std::swap(records, other.records);
+    std::swap(pending, other.pending);
+    std::swap(lastSync, other.lastSync);
+}
+
+vector<string> Journal::readRecords(const string& filename) {
+    vector<string> result;
+    LineReader reader;
+    if (!reader.open(filename)) return result;
+
+    string_view line;
+    while (reader.next(line)) {
+        // A record without its newline was torn by a crash mid-append
+        if (!reader.lastLineTerminated()) break;
+        result.emplace_back(line);
+    }
+    return result;
+}
@@ -0,0 +1,40 @@
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include <bits/stdc++.h>
+using namespace std;
+
+// Append-only record file with group commit. Every append is written to the
+// OS straight away, so it survives the process dying; fsync is batched and
+// issued once syncBatch records are pending or syncInterval has passed,
+// unless syncs are deferred to a caller that runs sync() itself.
+class Journal {
+public:
+    ~Journal();
+    bool open(const string& filename, int existingRecords = 0);
+    void close();
+    void append(const string& record);
+    void sync();
+    void truncate();
+    // Exchanges the open files, record counts and pending syncs of the two
+    void swap(Journal& other);
+    void deferSyncs(bool deferred) { syncsDeferred = deferred; }
+    bool isOpen() const { return fd >= 0; }
+    int size() const;
+    static vector<string> readRecords(const string& filename);
+
+private:
+    int fd = -1;
+    int records = 0;
+    int pending = 0;
+    atomic<bool> syncsDeferred{false};
+    // lock guards the fields; syncLock is held across fdatasync so appends
+    // do not wait for the disk and the descriptor is not closed under it
+    mutable mutex lock;
+    mutex syncLock;
+    chrono::steady_clock::time_point lastSync;
+    static const int syncBatch = 32;
+    static constexpr chrono::milliseconds syncInterval{1000};
+};
+
+#endif // JOURNAL_H
@@ -1,11 +1,94 @@
 #include "log.h"
+#include "../metrics/metrics.h"
+#include "../io/lines.h"
+#include "../io/files.h"
+#include "logimage.h"
+#include "partition.h"
+#include "../analytics/analytics.h"
 #include <iostream>
 #include <fstream>
 #include <iomanip>
 #include <ctime>
 #include <sstream>
+#include <fcntl.h>
+#include <unistd.h>
 
-void LogManager::displayOptions(const FoodList& foodList) {
+// Reads a YYYY-MM-DD date, returning its local midnight
+static bool promptDate(const string& prompt, time_t& date) {
+    cout << prompt;
+    string dateStr;
+    cin >> dateStr;
+
+    tm tm = {};
+    istringstream iss(dateStr);
+    iss >> get_time(&tm, "%Y-%m-%d");
+    if (iss.fail() || !iss.eof()) {
+        cin.clear();
+        cin.ignore(numeric_limits<streamsize>::max(), '\n');
+        cout << "Invalid date format. Please use YYYY-MM-DD.\n";
+        return false;
+    }
+
+    tm.tm_isdst = -1;
+    date = mktime(&tm);
+    if (date == -1) {
+        cout << "Invalid date.\n";
+        return false;
+    }
+    return true;
+}
+
+// The same local time of day, `days` calendar days earlier
+static time_t daysBefore(time_t date, int days) {
+    tm local;
+    localtime_r(&date, &local);
+    local.tm_mday -= days;
+    local.tm_isdst = -1;
+    return mktime(&local);
+}
+
+// "YYYY-MM" of a month counted as by LogManager::localMonth
+static string monthName(int month) {
+    int year = 1970 + (month >= 0 ? month / 12 : (month - 11) / 12);
+    char buffer[32];
+    snprintf(buffer, sizeof(buffer), "%04d-%02d", year, month - (year - 1970) * 12 + 1);
+    return buffer;
+}
+
+static bool parseMonth(string_view text, int& month) {
+    int year, number;
+    if (text.size() != 7 || text[4] != '-' || !parseNumber(text.substr(0, 4), year) ||
+        !parseNumber(text.substr(5), number) || number < 1 || number > 12) {
+        return false;
+    }
+    month = (year - 1970) * 12 + number - 1;
+    return true;
+}
+
+// Local midnight on the first of a month counted as by LogManager::localMonth
+static time_t monthStart(int month) {
+    tm local = {};
+    local.tm_year = 70;
+    local.tm_mon = month;
+    local.tm_mday = 1;
+    local.tm_isdst = -1;
+    return mktime(&local);
+}
+
+// Recent months are written as LogImage files, sealed ones compressed
+static bool isSealedFile(const string& file) {
+    return file.size() > 5 && file.compare(file.size() - 5, 5, ".logz") == 0;
+}
+
+static string manifestLine(int month, int count, const string& file) {
+    return "P|" + monthName(month) + "|" + to_string(count) + "|" + file + "\n";
+}
+
+static string partitionFileName(int month, int generation, bool sealed) {
+    return monthName(month) + ".g" + to_string(generation) + (sealed ? ".logz" : ".bin");
+}
+
+void LogManager::displayOptions(FoodList& foodList) {
     while (true) {
         cout << "\nFood Log Options:\n";
         cout << "1. Add food to log\n";
@@ -13,12 +96,15 @@ void LogManager::displayOptions(const FoodList& foodList) {
         cout << "3. View log for specific date\n";
         cout << "4. Delete entry\n";
         cout << "5. Undo\n";
-        cout << "6. Save Log\n";
-        cout << "7. Return to main menu\n";
+        cout << "6. Redo\n";
+        cout << "7. Save Log\n";
+        cout << "8. Calorie report\n";
+        cout << "9. Return to main menu\n";
         cout << "Enter choice: ";
         
         int choice;
         cin >> choice;
+        if (cin.fail() && cin.eof()) return;
         if (cin.fail()) {
             cin.clear();
             cin.ignore(numeric_limits<streamsize>::max(), '\n');
@@ -28,72 +114,48 @@ void LogManager::displayOptions(const FoodList& foodList) {
         
         switch (choice) {
             case 1: {
-                const vector<Food>& foods = foodList.getFoods();
-                if (foods.empty()) {
-                    cout << "No foods available. Please add foods first.\n";
+                cin.ignore(numeric_limits<streamsize>::max(), '\n');
+                FoodId id = foodList.selectFood("log");
+                if (id == noFood) {
                     break;
                 }
-                
-                cout << "\nAvailable foods:\n";
-                for (size_t i = 0; i < foods.size(); ++i) {
-                    cout << i+1 << ". " << foods[i].name << " (" << foods[i].calories << " cal)\n";
-                }
-                
-                cout << "Select food (number): ";
-                int foodChoice;
-                cin >> foodChoice;
-                
+
                 cout << "Enter number of servings: ";
                 int servings;
                 cin >> servings;
-                cin.ignore();
-                
-                if (foodChoice > 0 && foodChoice <= static_cast<int>(foods.size())) {
-                    addEntry(foods[foodChoice-1].name, servings, foods[foodChoice-1].calories);
-                    cout << "Entry added.\n";
-                }
-                else {
-                    cout << "Invalid selection.\n";
+                if (cin.fail() || servings <= 0) {
+                    if (cin.eof()) return;
+                    cin.clear();
+                    cin.ignore(numeric_limits<streamsize>::max(), '\n');
+                    cout << "Invalid servings.\n";
+                    break;
                 }
+                cin.ignore();
+
+                const Food& food = foodList.getFoods()[id];
+                addEntry(id, food.name, servings, food.calories, time(nullptr));
+                cout << "Entry added.\n";
                 break;
             }
             case 2:
                 viewLog();
                 break;
             case 3: {
-                cout << "Enter date (YYYY-MM-DD): ";
-                string dateStr;
-                cin >> dateStr;
-            
-                tm tm = {};
-                istringstream iss(dateStr);
-                iss >> get_time(&tm, "%Y-%m-%d");
-            
-                if (iss.fail() || !iss.eof()) {
-                    cin.clear();
-                    cin.ignore(numeric_limits<streamsize>::max(), '\n');
-                    cout << "Invalid date format. Please use YYYY-MM-DD.\n";
-                    continue;
-                }
-            
-                time_t date = mktime(&tm);
-                if (date == -1) {
-                    cout << "Invalid date.\n";
-                    continue;
+                time_t date;
+                if (promptDate("Enter date (YYYY-MM-DD): ", date)) {
+                    viewLog(date);
                 }
-            
-                viewLog(date);
                 break;
             }
             case 4: {
                 viewLog();
-                if (!entries.empty()) {
+                if (entryCount() > 0) {
                     cout << "Enter entry number to delete: ";
                     int index;
                     cin >> index;
                     cin.ignore();
                     
-                    if (index > 0 && index <= static_cast<int>(entries.size())) {
+                    if (index > 0 && index <= entryCount()) {
                         deleteEntry(index - 1);
                         cout << "Entry deleted.\n";
                     } else {
@@ -103,13 +165,19 @@ void LogManager::displayOptions(const FoodList& foodList) {
                 break;
             }
             case 5:
-                undo();
+                cout << (undo() ? "Undo successful.\n" : "Nothing to undo.\n");
                 break;
             case 6:
-                saveToFile("data/log.txt");
-                cout << "Log saved successfully.\n";
+                cout << (redo() ? "Redo successful.\n" : "Nothing to redo.\n");
                 break;
             case 7:
+                checkpoint();
+                cout << "Log saved successfully.\n";
+                break;
+            case 8:
+                reportOptions();
+                break;
+            case 9:
                 return;
             default:
                 cout << "Invalid choice. Try again.\n";
@@ -117,145 +185,1002 @@ void LogManager::displayOptions(const FoodList& foodList) {
     }
 }
 
-void LogManager::addEntry(const string& foodName, int servings, int calories, time_t date) {
-    saveState();
-    
+void LogManager::reportOptions() {
+    cout << "\nCalorie Report:\n";
+    cout << "1. Last 7 days\n";
+    cout << "2. Last 30 days\n";
+    cout << "3. Date range\n";
+    cout << "4. Weekly trend (last 8 weeks)\n";
+    cout << "5. Calories per day over a date range\n";
+    cout << "6. Calories per week over a date range\n";
+    cout << "7. Top foods over a date range\n";
+    cout << "Enter choice: ";
+
+    int choice;
+    cin >> choice;
+    if (cin.fail()) {
+        if (cin.eof()) return;
+        cin.clear();
+        cin.ignore(numeric_limits<streamsize>::max(), '\n');
+        cout << "Invalid input.\n";
+        return;
+    }
+
+    time_t today = time(nullptr);
+    switch (choice) {
+        case 1:
+            printReport(daysBefore(today, 6), today);
+            break;
+        case 2:
+            printReport(daysBefore(today, 29), today);
+            break;
+        case 3: {
+            time_t from, to;
+            if (promptDate("Enter start date (YYYY-MM-DD): ", from) &&
+                promptDate("Enter end date (YYYY-MM-DD): ", to)) {
+                printReport(from, to);
+            }
+            break;
+        }
+        case 4:
+            for (int week = 7; week >= 0; --week) {
+                printReport(daysBefore(today, week * 7 + 6), daysBefore(today, week * 7));
+            }
+            break;
+        case 5:
+        case 6:
+        case 7: {
+            time_t from, to;
+            if (promptDate("Enter start date (YYYY-MM-DD): ", from) &&
+                promptDate("Enter end date (YYYY-MM-DD): ", to)) {
+                printGroupReport(buildCalorieReport(*this, from, to), choice);
+            }
+            break;
+        }
+        default:
+            cout << "Invalid choice.\n";
+    }
+}
+
+// Prints one grouping of a report: 5 by day, 6 by week, 7 top foods
+void LogManager::printGroupReport(const CalorieReport& report, int grouping) const {
+    BufferedWriter out(cout);
+    if (report.entries == 0) {
+        out << "No entries in this range.\n";
+        return;
+    }
+
+    if (grouping == 5) {
+        for (size_t day = 0; day < report.days.size(); ++day) {
+            const GroupTotal& total = report.days[day];
+            if (total.entries == 0) continue;
+            out << dayName(report.firstDay + day) << ": " << total.calories << " calories, " << total.entries
+                << " entries\n";
+        }
+    } else if (grouping == 6) {
+        for (size_t week = 0; week < report.weeks.size(); ++week) {
+            const GroupTotal& total = report.weeks[week];
+            if (total.entries == 0) continue;
+            out << "Week of " << dayName(report.firstDay + week * 7) << ": " << total.calories << " calories, "
+                << total.entries << " entries\n";
+        }
+    } else {
+        for (size_t rank = 0; rank < report.topFoods.size(); ++rank) {
+            const GroupTotal& total = report.topFoods[rank].second;
+            out << rank + 1 << ". " << symbols().text(report.topFoods[rank].first) << ": " << total.calories
+                << " calories, " << total.entries << " entries\n";
+        }
+    }
+    out << "Total: " << report.calories << " calories in " << report.entries << " entries of "
+        << report.smallestEntry << " to " << report.largestEntry << " calories\n";
+}
+
+void LogManager::printReport(time_t from, time_t to) const {
+    char first[20], last[20];
+    tm local;
+    strftime(first, sizeof(first), "%Y-%m-%d", localtime_r(&from, &local));
+    strftime(last, sizeof(last), "%Y-%m-%d", localtime_r(&to, &local));
+    int days = max(0, localDay(to) - localDay(from) + 1);
+
+    cout << first << " to " << last << ": " << getTotalCalories(from, to) << " calories, logged on "
+         << getLoggedDays(from, to) << " of " << days << " days, average "
+         << lround(getAverageCalories(from, to)) << " per logged day\n";
+}
+
+void LogManager::addEntry(FoodId food, Symbol foodName, int servings, int calories, time_t date) {
+    YADA_TIMED("log_add_entry");
     LogEntry entry;
+    entry.food = food;
     entry.foodName = foodName;
     entry.servings = servings;
     entry.calories = calories * servings;
-    entry.date = (date == 0) ? time(nullptr) : date;
-    
-    entries.push_back(entry);
+    entry.date = date;
+    entry.day = localDay(entry.date);
+
+    // Entries stay in date order, with later entries of the same second last
+    int month = localMonth(entry.date);
+    int index;
+    {
+        lock_guard<mutex> guard(stateLock);
+        index = entriesBefore(month) + loadPartition(month).entries.insertionRow(entry.date);
+    }
+
+    LogAction action{LogAction::Insert, index, entry};
+    if (applyAction(action, false)) {
+        recordAction(action);
+    }
 }
 
-void LogManager::deleteEntry(int index) {
-    if (index >= 0 && index < static_cast<int>(entries.size())) {
-        saveState();
-        entries.erase(entries.begin() + index);
+bool LogManager::deleteEntry(int index) {
+    YADA_TIMED("log_delete_entry");
+    if (index < 0 || index >= totalEntries) {
+        return false;
     }
+
+    LogAction action{LogAction::Erase, index, LogEntry()};
+    {
+        lock_guard<mutex> guard(stateLock);
+        int offset;
+        const LogColumns& list = loadPartition(partitionOf(index, offset)).entries;
+        if (offset >= static_cast<int>(list.size())) return false;
+        action.entry = list.entry(offset);
+    }
+    if (!applyAction(action, false)) {
+        return false;
+    }
+    recordAction(action);
+    return true;
 }
 
-void LogManager::undo() {
-    if (!undoStack.empty()) {
-        entries = undoStack.back();
-        undoStack.pop_back();
-        cout << "Undo successful.\n";
-    } 
-    else {
-        cout << "Nothing to undo.\n";
+bool LogManager::undo() {
+    YADA_TIMED("log_undo");
+    if (historyCursor == 0) {
+        return false;
+    }
+
+    if (!applyAction(history[(historyStart + historyCursor - 1) % historyCapacity], true)) {
+        return false;
+    }
+    --historyCursor;
+    return true;
+}
+
+bool LogManager::redo() {
+    YADA_TIMED("log_redo");
+    if (historyCursor == historySize) {
+        return false;
+    }
+
+    if (!applyAction(history[(historyStart + historyCursor) % historyCapacity], false)) {
+        return false;
     }
+    ++historyCursor;
+    return true;
 }
 
-void LogManager::saveState() {
-    undoStack.push_back(entries);
-    // Keep undo stack manageable
-    if (undoStack.size() > 50) {
-        undoStack.erase(undoStack.begin());
+void LogManager::recordAction(const LogAction& action) {
+    // A new action discards whatever was still redoable
+    historySize = historyCursor;
+    if (historySize == historyCapacity) {
+        // Keep undo history manageable by dropping the oldest action
+        historyStart = (historyStart + 1) % historyCapacity;
+        --historySize;
+    }
+    history[(historyStart + historySize) % historyCapacity] = action;
+    historyCursor = ++historySize;
+}
+
+// "A|index|servings|calories|date|name" adds an entry and "D|..." deletes
+// it. The name comes last and runs to the end of the record, so it may hold
+// any character but a newline.
+static string journalRecord(bool insert, const LogAction& action) {
+    const LogEntry& entry = action.entry;
+    return (insert ? "A|" : "D|") + to_string(action.index) + "|" + to_string(entry.servings) + "|" +
+           to_string(entry.calories) + "|" + to_string(entry.date) + "|" + string(symbols().text(entry.foodName));
+}
+
+// Returns false, changing nothing, when the entry number does not fit the
+// log, for example after a partition failed to load
+bool LogManager::applyAction(const LogAction& action, bool inverse) {
+    bool insert = (action.kind == LogAction::Insert) != inverse;
+    {
+        lock_guard<mutex> guard(stateLock);
+        if (!(insert ? insertEntry(action.index, action.entry) : eraseEntry(action.index))) {
+            return false;
+        }
+        journal.append(journalRecord(insert, action));
+        publishView();
+    }
+
+    if (changeListener) {
+        changeListener();
+    } else if (checkpointDue()) {
+        checkpoint();
     }
+    return true;
+}
+
+// Fold the journal into the partition files before replay gets long.
+// Waiting for at least as many records as there are entries in memory
+// keeps the rewrite amortized O(1) per change even when millions of
+// changes stream in.
+bool LogManager::checkpointDue() const {
+    return journal.size() >= max(checkpointInterval, residentEntries);
+}
+
+void LogManager::setChangeListener(function<void()> listener) {
+    changeListener = move(listener);
+    journal.deferSyncs(static_cast<bool>(changeListener));
+}
+
+void LogManager::flush() {
+    journal.sync();
+    bool due;
+    {
+        lock_guard<mutex> guard(stateLock);
+        due = checkpointDue();
+    }
+    if (due) {
+        checkpoint();
+    }
+}
+
+// Reads an "A|index|servings|calories|date|name" or "D|..." journal record
+static bool parseRecord(string_view record, LogAction& action) {
+    if (record.size() < 2 || (record[0] != 'A' && record[0] != 'D') || record[1] != '|') {
+        return false;
+    }
+    FieldScanner fields(record, '|');
+    string_view tokens[5];
+    int count = 0;
+    string_view field;
+    while (count < 5 && fields.next(field)) {
+        tokens[count++] = field;
+    }
+    string_view name = fields.rest();
+    LogEntry& entry = action.entry;
+    if (count < 5 || name.empty() || !parseNumber(tokens[1], action.index) ||
+        !parseNumber(tokens[2], entry.servings) || !parseNumber(tokens[3], entry.calories) ||
+        !parseNumber(tokens[4], entry.date)) {
+        return false;
+    }
+    action.kind = record[0] == 'A' ? LogAction::Insert : LogAction::Erase;
+    entry.foodName = symbols().intern(name);
+    entry.day = LogManager::localDay(entry.date);
+    return true;
+}
+
+int LogManager::localDay(time_t date) {
+    tm local;
+    // Out of localtime's range; such dates are refused before they reach the log
+    if (localtime_r(&date, &local) == nullptr) return 0;
+
+    // Days since 1970-01-01 of the local calendar date (civil-from-days inverse)
+    int y = local.tm_year + 1900;
+    int m = local.tm_mon + 1;
+    int d = local.tm_mday;
+    y -= m <= 2;
+    int era = (y >= 0 ? y : y - 399) / 400;
+    int yoe = y - era * 400;
+    int doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    int doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + doe - 719468;
 }
 
-void LogManager::viewLog(time_t date) const {
+int LogManager::localMonth(time_t date) {
+    tm local;
+    if (localtime_r(&date, &local) == nullptr) return 0;
+    return (local.tm_year - 70) * 12 + local.tm_mon;
+}
+
+int LogManager::entriesBefore(int month) const {
+    int count = 0;
+    for (auto it = partitions.begin(); it != partitions.end() && it->first < month; ++it) {
+        count += it->second.count;
+    }
+    return count;
+}
+
+// The month holding entry number index, and index's offset within it
+int LogManager::partitionOf(int index, int& offset) const {
+    offset = index;
+    for (const auto& partition : partitions) {
+        if (offset < partition.second.count) return partition.first;
+        offset -= partition.second.count;
+    }
+    return partitions.empty() ? 0 : partitions.rbegin()->first;
+}
+
+// Finds or adds the month's partition and reads its entries if they are
+// still on disk. Callers hold stateLock, except while loading.
+LogManager::Partition& LogManager::loadPartition(int month) {
+    Partition& partition = partitions[month];
+    if (partition.loaded) return partition;
+    partition.loaded = true;
+    if (partition.file.empty()) return partition;
+
+    LogColumns entries;
+    if (!readPartition(partition.file, entries) || static_cast<int>(entries.size()) != partition.count) {
+        // Keep the file for inspection and go on without its entries; the
+        // next checkpoint drops it from the manifest
+        string path = logDir + "/" + partition.file;
+        cerr << "Error reading log partition, moved to " << path << ".damaged" << endl;
+        rename(path.c_str(), (path + ".damaged").c_str());
+        int endDay = localDay(monthStart(month + 1));
+        for (int day = localDay(monthStart(month)); day < endDay; ++day) {
+            dayTotals.add(day, -dayTotals.caloriesOn(day), -dayTotals.entriesOn(day));
+            if (publishing) unpublishedDays.push_back(day);
+        }
+        totalEntries -= partition.count;
+        partition.count = 0;
+        partition.file.clear();
+        ++partition.version;
+        return partition;
+    }
+
+    if (boundFoods) {
+        for (size_t row = 0; row < entries.size(); ++row) {
+            entries.setFood(row, boundFoods->idOf(entries.foodName(row)));
+        }
+    }
+    partition.entries = move(entries);
+    residentEntries += partition.count;
+    return partition;
+}
+
+bool LogManager::readPartition(const string& file, LogColumns& entries) const {
+    string path = logDir + "/" + file;
+    if (isSealedFile(file)) {
+        return SealedPartition::read(path, entries);
+    }
+
+    LogImage image;
+    if (!image.open(path) || !image.verify()) {
+        return false;
+    }
+    uint32_t count = image.entryCount();
+    entries.release();
+    entries.reserve(count);
+    for (uint32_t i = 0; i < count; ++i) {
+        LogEntry entry;
+        entry.foodName = symbols().intern(image.entryFoodName(i));
+        entry.servings = image.entryServings(i);
+        entry.calories = image.entryCalories(i);
+        entry.date = image.entryDate(i);
+        entry.day = localDay(entry.date);
+        entries.append(entry);
+    }
+    return true;
+}
+
+// False when index is not a place for the entry in its month's date order
+bool LogManager::insertEntry(int index, const LogEntry& entry) {
+    int month = localMonth(entry.date);
+    int offset = index - entriesBefore(month);
+    Partition& partition = loadPartition(month);
+    LogColumns& list = partition.entries;
+    int size = list.size();
+    if (offset < 0 || offset > size || (offset > 0 && list.date(offset - 1) > entry.date) ||
+        (offset < size && list.date(offset) < entry.date)) {
+        return false;
+    }
+
+    list.insert(offset, entry);
+    ++partition.count;
+    ++partition.version;
+    ++totalEntries;
+    ++residentEntries;
+    dayTotals.add(entry.day, entry.calories, 1);
+    if (publishing) {
+        unpublishedDays.push_back(entry.day);
+    }
+    return true;
+}
+
+bool LogManager::eraseEntry(int index) {
+    if (index < 0 || index >= totalEntries) {
+        return false;
+    }
+    int offset;
+    Partition& partition = loadPartition(partitionOf(index, offset));
+    LogColumns& list = partition.entries;
+    if (offset >= static_cast<int>(list.size())) {
+        return false;
+    }
+
+    int day = list.day(offset);
+    dayTotals.add(day, -list.calories(offset), -1);
+    if (publishing) {
+        unpublishedDays.push_back(day);
+    }
+    list.erase(offset);
+    --partition.count;
+    ++partition.version;
+    --totalEntries;
+    --residentEntries;
+    return true;
+}
+
+// Applies a replayed journal record. Entry numbers shift when a damaged
+// partition is dropped, so a record falls back to finding its entry, or
+// its place, by date when the numbered one does not fit.
+bool LogManager::replayAction(const LogAction& action) {
+    const LogEntry& entry = action.entry;
+    int month = localMonth(entry.date);
+    const LogColumns& list = loadPartition(month).entries;
+    int before = entriesBefore(month);
+    if (action.kind == LogAction::Insert) {
+        return insertEntry(action.index, entry) || insertEntry(before + list.insertionRow(entry.date), entry);
+    }
+
+    auto matches = [&](int row) {
+        return list.date(row) == entry.date && list.foodName(row) == entry.foodName &&
+               list.calories(row) == entry.calories && list.servings(row) == entry.servings;
+    };
+    int offset = action.index - before;
+    if (offset >= 0 && offset < static_cast<int>(list.size()) && matches(offset)) {
+        return eraseEntry(action.index);
+    }
+    for (int row = static_cast<int>(list.insertionRow(entry.date)) - 1; row >= 0 && list.date(row) == entry.date; --row) {
+        if (matches(row)) return eraseEntry(before + row);
+    }
+    return false;
+}
+
+const Published<LogView>& LogManager::view() {
+    lock_guard<mutex> guard(stateLock);
+    if (!publishing) {
+        publishing = true;
+        republishView();
+    }
+    return publishedView;
+}
+
+void LogManager::republishView() {
+    viewDraft = LogView();
+    unpublishedDays.clear();
+    dayTotals.forEachDay([this](int day, long, int) { unpublishedDays.push_back(day); });
+    publishView();
+}
+
+// Applies the totals of the changed days to the draft and publishes a copy of it
+void LogManager::publishView() {
+    if (!publishing) return;
+    sort(unpublishedDays.begin(), unpublishedDays.end());
+    unpublishedDays.erase(unique(unpublishedDays.begin(), unpublishedDays.end()), unpublishedDays.end());
+    for (int day : unpublishedDays) {
+        viewDraft.setDay(day, dayTotals.caloriesOn(day), dayTotals.entriesOn(day));
+    }
+    unpublishedDays.clear();
+    publishedView.publish(make_shared<const LogView>(viewDraft));
+}
+
+void LogManager::viewLog(time_t date) {
+    YADA_TIMED("log_view");
     if (date == 0) {
         date = time(nullptr);
     }
 
-    tm* searchTime = localtime(&date);
-    searchTime->tm_hour = 0;
-    searchTime->tm_min = 0;
-    searchTime->tm_sec = 0;
-    time_t normalizedDate = mktime(searchTime);
-
     cout << "\nFood Log:\n";
-    bool found = false;
     int totalCalories = 0;
 
     char buffer[80];
-    strftime(buffer, sizeof(buffer), "%Y-%m-%d", localtime(&normalizedDate));
+    tm local;
+    strftime(buffer, sizeof(buffer), "%Y-%m-%d", localtime_r(&date, &local));
     cout << "Date: " << buffer << "\n\n";
 
-    for (size_t i = 0; i < entries.size(); ++i) {
-        tm* entryTime = localtime(&entries[i].date);
-        entryTime->tm_hour = 0;
-        entryTime->tm_min = 0;
-        entryTime->tm_sec = 0;
-        time_t normalizedEntryDate = mktime(entryTime);
-
-        if (normalizedEntryDate == normalizedDate) {
-            cout << i + 1 << ". " << entries[i].foodName
-                 << " - Servings: " << entries[i].servings
-                 << ", Calories: " << entries[i].calories << "\n";
-            totalCalories += entries[i].calories;
-            found = true;
+    // The day's entries are a run within its month, numbered after the
+    // entries of earlier months
+    int month = localMonth(date);
+    int before = 0;
+    const LogColumns* list = nullptr;
+    {
+        // Months without a partition have no entries; looking them up with
+        // loadPartition would add an empty one for every date viewed
+        lock_guard<mutex> guard(stateLock);
+        if (partitions.count(month)) {
+            list = &loadPartition(month).entries;
+            before = entriesBefore(month);
         }
     }
-
-    if (!found) {
+    size_t first = 0, last = 0;
+    int day = localDay(date);
+    if (list) {
+        list->dayRows(day, day, first, last);
+    }
+    if (first == last) {
         cout << "No entries for this date.\n";
+        return;
     }
-    else {
-        cout << "\nTotal calories: " << totalCalories << "\n";
+
+    for (size_t row = first; row < last; ++row) {
+        cout << before + row + 1 << ". " << symbols().text(list->foodName(row))
+             << " - Servings: " << list->servings(row)
+             << ", Calories: " << list->calories(row) << "\n";
+        totalCalories += list->calories(row);
     }
+
+    cout << "\nTotal calories: " << totalCalories << "\n";
 }
 
-int LogManager::getTotalCalories(time_t date) const {
-    int total = 0;
-    for (const auto& entry : entries) {
-        tm* entryTime = localtime(&entry.date);
-        tm* searchTime = localtime(&date);
-        
-        if (entryTime->tm_year == searchTime->tm_year &&
-            entryTime->tm_mon == searchTime->tm_mon &&
-            entryTime->tm_mday == searchTime->tm_mday) {
-            total += entry.calories;
+void LogManager::scanEntries(time_t from, time_t to,
+                             const function<void(const LogColumns&, size_t, size_t)>& visit) {
+    int firstDay = localDay(from);
+    int lastDay = localDay(to);
+    lock_guard<mutex> guard(stateLock);
+    auto end = partitions.upper_bound(localMonth(to));
+    for (auto it = partitions.lower_bound(localMonth(from)); it != end; ++it) {
+        if (it->second.count == 0) continue;
+        const LogColumns& rows = loadPartition(it->first).entries;
+        size_t first, last;
+        rows.dayRows(firstDay, lastDay, first, last);
+        if (first < last) {
+            visit(rows, first, last);
         }
     }
-    return total;
 }
 
-void LogManager::saveToFile(const string& filename) {
-    ofstream outFile(filename);
-    if (!outFile) {
-        cerr << "Error opening file for writing: " << filename << endl;
+int LogManager::getTotalCalories(time_t date) const {
+    YADA_TIMED("log_total_calories");
+    return dayTotals.caloriesOn(localDay(date));
+}
+
+long LogManager::getTotalCalories(time_t from, time_t to) const {
+    YADA_TIMED("log_range_calories");
+    return dayTotals.calories(localDay(from), localDay(to));
+}
+
+int LogManager::getLoggedDays(time_t from, time_t to) const {
+    return dayTotals.loggedDays(localDay(from), localDay(to));
+}
+
+double LogManager::getAverageCalories(time_t from, time_t to) const {
+    // Days without any entry were not tracked, so they do not pull the average down
+    int days = getLoggedDays(from, to);
+    return days == 0 ? 0.0 : static_cast<double>(getTotalCalories(from, to)) / days;
+}
+
+void LogManager::checkpoint() {
+    YADA_TIMED("log_save");
+    lock_guard<mutex> saving(saveLock);
+    // The old journal is only dropped once a manifest holds its changes
+    if (snapshotPending) {
+        if (!writeSnapshot(pendingSnapshot)) return;
+        commitSnapshot(pendingSnapshot);
+        unlink(oldJournalFile.c_str());
+        pendingSnapshot = LogSnapshot();
+        snapshotPending = false;
+    }
+
+    // The journal is renamed aside while still open, so changes keep landing
+    // in it, and the next one is opened beside it; only swapping the two and
+    // copying the partitions happen under stateLock. Changes made while the
+    // files are written go to the next generation's journal.
+    if (journal.size() <= 1) return;
+    if (rename(journalFile.c_str(), oldJournalFile.c_str()) != 0) {
+        cerr << "Error renaming journal: " << journalFile << endl;
+        return;
+    }
+    Journal next;
+    if (!next.open(journalFile)) {
+        rename(oldJournalFile.c_str(), journalFile.c_str());
         return;
     }
-    
-    for (const auto& entry : entries) {
-        outFile << entry.foodName << "|" << entry.servings << "|" 
-               << entry.calories << "|" << entry.date << "\n";
+    next.append("G|" + to_string(generation + 1));
+    LogSnapshot snapshot;
+    {
+        lock_guard<mutex> guard(stateLock);
+        journal.swap(next);
+        ++generation;
+        snapshot = takeSnapshot(generation);
+    }
+    next.close();
+    readSealing(snapshot);
+
+    if (writeSnapshot(snapshot)) {
+        commitSnapshot(snapshot);
+        unlink(oldJournalFile.c_str());
+    } else {
+        pendingSnapshot = move(snapshot);
+        snapshotPending = true;
+    }
+}
+
+// Copies the partitions changed since they were last written, plus recent
+// ones whose month is now old enough to seal, and lists every partition
+// and day total in a new manifest. Callers hold stateLock; months to seal
+// that are not loaded are left to readSealing.
+LogManager::LogSnapshot LogManager::takeSnapshot(int snapshotGeneration) const {
+    LogSnapshot snapshot;
+    snapshot.generation = snapshotGeneration;
+    int firstRecent = localMonth(time(nullptr)) - recentMonths + 1;
+    for (const auto& entry : partitions) {
+        int month = entry.first;
+        const Partition& partition = entry.second;
+        bool sealed = month < firstRecent;
+        bool reseal = sealed && !partition.file.empty() && !isSealedFile(partition.file);
+        // Only loaded partitions change
+        if (partition.version == partition.writtenVersion && !reseal) {
+            if (!partition.file.empty()) {
+                snapshot.partitionLines[month] = manifestLine(month, partition.count, partition.file);
+            }
+            continue;
+        }
+
+        PartitionFile written{month, partition.count, "", partition.version, {}, ""};
+        if (partition.count > 0) {
+            if (partition.loaded) {
+                written.entries = partition.entries;
+            } else {
+                written.source = partition.file;
+            }
+            written.file = partitionFileName(month, snapshotGeneration, sealed);
+            snapshot.partitionLines[month] = manifestLine(month, partition.count, written.file);
+        }
+        if (!partition.file.empty()) {
+            snapshot.obsoleteFiles.push_back(partition.file);
+        }
+        snapshot.partitions.push_back(move(written));
+    }
+    ostringstream days;
+    dayTotals.forEachDay([&days](int day, long calories, int entries) {
+        days << "D|" << day << "|" << calories << "|" << entries << "\n";
+    });
+    snapshot.dayLines = days.str();
+    return snapshot;
+}
+
+// Reads the months takeSnapshot left to seal from their files; one that
+// cannot be read stays as it is
+void LogManager::readSealing(LogSnapshot& snapshot) const {
+    for (auto it = snapshot.partitions.begin(); it != snapshot.partitions.end();) {
+        if (it->source.empty() || readPartition(it->source, it->entries)) {
+            ++it;
+            continue;
+        }
+        snapshot.partitionLines[it->month] = manifestLine(it->month, it->count, it->source);
+        auto& obsolete = snapshot.obsoleteFiles;
+        obsolete.erase(remove(obsolete.begin(), obsolete.end(), it->source), obsolete.end());
+        it = snapshot.partitions.erase(it);
+    }
+}
+
+string LogManager::LogSnapshot::manifest() const {
+    string text = "#generation " + to_string(generation) + "\n";
+    for (const auto& line : partitionLines) {
+        text += line.second;
+    }
+    return text + dayLines;
+}
+
+// Writes the partition files, then the manifest that refers to them
+bool LogManager::writeSnapshot(const LogSnapshot& snapshot) const {
+    error_code error;
+    filesystem::create_directories(logDir, error);
+    for (const auto& partition : snapshot.partitions) {
+        if (partition.file.empty()) continue;
+        string path = logDir + "/" + partition.file;
+        bool written = isSealedFile(partition.file) ? SealedPartition::write(path, partition.entries)
+                                                    : LogImage::write(path, partition.entries, snapshot.generation);
+        if (!written) return false;
+    }
+    return writeFileAtomically(manifestFile, snapshot.manifest());
+}
+
+// Records the files a written snapshot put in place and removes the ones
+// they replace
+void LogManager::commitSnapshot(const LogSnapshot& snapshot) {
+    {
+        lock_guard<mutex> guard(stateLock);
+        for (const auto& written : snapshot.partitions) {
+            Partition& partition = partitions[written.month];
+            partition.file = written.file;
+            partition.writtenVersion = written.version;
+        }
     }
-    
-    outFile.close();
+    for (const auto& file : snapshot.obsoleteFiles) {
+        unlink((logDir + "/" + file).c_str());
+    }
+}
+
+// Entries parsed from one chunk of the log file, with food names still
+// pointing into the file and line numbers relative to the chunk
+struct LogChunk {
+    vector<LogEntry> entries;
+    vector<string_view> names;
+    vector<ParseError> errors;
+    long lines = 0;
+};
+
+static void parseLogChunk(string_view text, LogChunk& chunk) {
+    chunk.lines = forEachLine(text, [&](string_view line, long lineNumber) {
+        // Files edited on Windows end their lines with "\r\n"
+        if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+        if (line.empty()) return;
+
+        FieldScanner fields(line, '|');
+        string_view tokens[4];
+        int count = 0;
+        string_view field;
+        while (count < 5 && fields.next(field)) {
+            if (count < 4) tokens[count] = field;
+            ++count;
+        }
+        if (count != 4) {
+            chunk.errors.push_back({lineNumber, "expected 4 fields, found " + to_string(count)});
+            return;
+        }
+
+        LogEntry entry;
+        if (!parseNumber(tokens[1], entry.servings)) {
+            chunk.errors.push_back({lineNumber, "bad servings '" + string(tokens[1]) + "'"});
+            return;
+        }
+        if (!parseNumber(tokens[2], entry.calories)) {
+            chunk.errors.push_back({lineNumber, "bad calories '" + string(tokens[2]) + "'"});
+            return;
+        }
+        if (!parseNumber(tokens[3], entry.date) || entry.date < LogManager::earliestDate ||
+            entry.date > LogManager::latestDate) {
+            chunk.errors.push_back({lineNumber, "bad date '" + string(tokens[3]) + "'"});
+            return;
+        }
+        entry.day = LogManager::localDay(entry.date);
+        chunk.entries.push_back(entry);
+        chunk.names.push_back(tokens[0]);
+    });
 }
 
 void LogManager::loadFromFile() {
-    string filename = logFile;
-    ifstream inFile(filename);
-    if (!inFile) {
-        cerr << "File not found, starting with empty log: " << filename << endl;
+    YADA_TIMED("log_load");
+    partitions.clear();
+    dayTotals.clear();
+    unpublishedDays.clear();
+    totalEntries = 0;
+    residentEntries = 0;
+    generation = 0;
+    int firstRecent = localMonth(time(nullptr)) - recentMonths + 1;
+
+    // The single log.txt of older versions is converted once. Its journal
+    // numbers entries in file order, so it is replayed before the entries
+    // are sorted into partitions.
+    bool legacy = !readManifest();
+    vector<LogEntry> legacyEntries;
+    function<bool(const LogAction&)> apply;
+    if (legacy) {
+        readLegacyLog(legacyEntries);
+        apply = [&legacyEntries](const LogAction& action) {
+            int size = legacyEntries.size();
+            if (action.kind == LogAction::Insert) {
+                if (action.index < 0 || action.index > size) return false;
+                legacyEntries.insert(legacyEntries.begin() + action.index, action.entry);
+            } else {
+                if (action.index < 0 || action.index >= size) return false;
+                legacyEntries.erase(legacyEntries.begin() + action.index);
+            }
+            return true;
+        };
+    } else {
+        removeStaleFiles();
+        for (auto it = partitions.lower_bound(firstRecent); it != partitions.end(); ++it) {
+            loadPartition(it->first);
+        }
+        apply = [this](const LogAction& action) { return replayAction(action); };
+    }
+
+    // A crash mid-checkpoint leaves the previous journal renamed aside; its
+    // changes come first if the manifest was not rewritten yet
+    bool clean = !legacy && access(oldJournalFile.c_str(), F_OK) != 0;
+    int records, oldGeneration, newGeneration;
+    replayJournal(oldJournalFile, records, oldGeneration, apply);
+    clean = replayJournal(journalFile, records, newGeneration, apply) && clean;
+
+    if (legacy) {
+        stable_sort(legacyEntries.begin(), legacyEntries.end(),
+                    [](const LogEntry& a, const LogEntry& b) { return a.date < b.date; });
+        for (const auto& entry : legacyEntries) {
+            Partition& partition = partitions[localMonth(entry.date)];
+            partition.loaded = true;
+            partition.entries.append(entry);
+            ++partition.count;
+            ++partition.version;
+            dayTotals.add(entry.day, entry.calories, 1);
+        }
+        totalEntries = residentEntries = legacyEntries.size();
+    }
+    if (publishing) {
+        republishView();
+    }
+    if (clean) {
+        journal.open(journalFile, records);
         return;
     }
-    
-    entries.clear();
-    string line;
-    while (getline(inFile, line)) {
-        istringstream iss(line);
-        string token;
-        vector<string> tokens;
-        
-        while (getline(iss, token, '|')) {
-            tokens.push_back(token);
+
+    // Otherwise start over from a manifest past both journals' generations,
+    // so neither replays again even if a crash interrupts the cleanup
+    int previous = generation;
+    generation = max({generation, oldGeneration, newGeneration}) + 1;
+    LogSnapshot snapshot = takeSnapshot(generation);
+    readSealing(snapshot);
+    if (!writeSnapshot(snapshot)) {
+        generation = previous;
+        journal.open(journalFile, records);
+        return;
+    }
+    commitSnapshot(snapshot);
+    unlink(oldJournalFile.c_str());
+    journal.open(journalFile);
+    journal.truncate();
+    journal.append("G|" + to_string(generation));
+    journal.sync();
+
+    // A converted log keeps only its recent months in memory, as if loaded
+    // from the partitions
+    if (legacy) {
+        for (auto it = partitions.begin(); it != partitions.end() && it->first < firstRecent; ++it) {
+            Partition& partition = it->second;
+            if (partition.version != partition.writtenVersion) continue;
+            residentEntries -= partition.entries.size();
+            partition.entries.release();
+            partition.loaded = false;
         }
-        
-        if (tokens.size() == 4) {
-            LogEntry entry;
-            entry.foodName = tokens[0];
-            entry.servings = stoi(tokens[1]);
-            entry.calories = stoi(tokens[2]);
-            entry.date = stol(tokens[3]);
-            entries.push_back(entry);
+    }
+}
+
+// Reads the partition list and day totals; false if there is no manifest yet
+bool LogManager::readManifest() {
+    MappedFile file;
+    if (!file.open(manifestFile)) {
+        return false;
+    }
+
+    string_view text = file.text();
+    long lineOffset = 0;
+    const string_view header = "#generation ";
+    if (text.substr(0, header.size()) == header) {
+        size_t end = text.find('\n');
+        parseNumber(text.substr(header.size(), end - header.size()), generation);
+        text = end == string_view::npos ? string_view() : text.substr(end + 1);
+        lineOffset = 1;
+    }
+
+    vector<ParseError> errors;
+    forEachLine(text, [&](string_view line, long lineNumber) {
+        if (line.empty()) return;
+        FieldScanner fields(line, '|');
+        string_view tokens[4];
+        int count = 0;
+        string_view field;
+        while (count < 5 && fields.next(field)) {
+            if (count < 4) tokens[count] = field;
+            ++count;
+        }
+
+        int month, entries, day;
+        long calories;
+        if (count == 4 && tokens[0] == "P" && parseMonth(tokens[1], month) && parseNumber(tokens[2], entries) &&
+            entries > 0 && !tokens[3].empty()) {
+            Partition& partition = partitions[month];
+            partition.count = entries;
+            partition.file = string(tokens[3]);
+            totalEntries += entries;
+        } else if (count == 4 && tokens[0] == "D" && parseNumber(tokens[1], day) &&
+                   parseNumber(tokens[2], calories) && parseNumber(tokens[3], entries)) {
+            dayTotals.add(day, calories, entries);
+        } else {
+            errors.push_back({lineNumber + lineOffset, "bad manifest line '" + string(line) + "'"});
+        }
+    });
+    reportErrors(manifestFile, errors);
+    return true;
+}
+
+// Partition files a crash left behind before the manifest naming them was written
+void LogManager::removeStaleFiles() const {
+    set<string> current;
+    for (const auto& partition : partitions) {
+        current.insert(partition.second.file);
+    }
+    error_code error;
+    for (const auto& item : filesystem::directory_iterator(logDir, error)) {
+        string name = item.path().filename().string();
+        bool partitionFile = name.size() > 4 && (isSealedFile(name) || name.compare(name.size() - 4, 4, ".bin") == 0 ||
+                                                 name.compare(name.size() - 4, 4, ".tmp") == 0);
+        if (partitionFile && !current.count(name)) {
+            unlink(item.path().c_str());
+        }
+    }
+}
+
+void LogManager::readLegacyLog(vector<LogEntry>& entries) {
+    string filename = legacyLogFile;
+    MappedFile file;
+    if (!file.open(filename)) {
+        cerr << "File not found, starting with empty log: " << filename << endl;
+    }
+
+    // The first line names the journal generation the snapshot starts from;
+    // logs written before generations have none and count as generation 0
+    string_view text = file.text();
+    generation = 0;
+    long lineOffset = 0;
+    const string_view header = "#generation ";
+    if (text.substr(0, header.size()) == header) {
+        size_t end = text.find('\n');
+        parseNumber(text.substr(header.size(), end - header.size()), generation);
+        text = end == string_view::npos ? string_view() : text.substr(end + 1);
+        lineOffset = 1;
+    }
+
+    // Large logs are parsed in line-aligned chunks on several threads, then
+    // appended in file order. Names are interned during the merge since the
+    // symbol table would serialize the workers anyway.
+    vector<LogChunk> chunks = parseChunks<LogChunk>(lineChunks(text), parseLogChunk);
+
+    size_t total = 0;
+    for (const auto& chunk : chunks) {
+        total += chunk.entries.size();
+    }
+    entries.reserve(total);
+
+    vector<ParseError> errors;
+    for (auto& chunk : chunks) {
+        for (size_t i = 0; i < chunk.entries.size(); ++i) {
+            chunk.entries[i].foodName = symbols().intern(chunk.names[i]);
+            entries.push_back(chunk.entries[i]);
+        }
+        for (auto error : chunk.errors) {
+            error.line += lineOffset;
+            errors.push_back(error);
+        }
+        lineOffset += chunk.lines;
+    }
+    reportErrors(filename, errors);
+}
+
+
+// Replays the changes in filename that the manifest does not include yet,
+// stopping at the first record that does not apply cleanly. Returns true if
+// the journal can be appended to as it is.
+bool LogManager::replayJournal(const string& filename, int& records, int& journalGeneration,
+                               const function<bool(const LogAction&)>& apply) {
+    vector<string> lines = Journal::readRecords(filename);
+    records = lines.size();
+    journalGeneration = 0;
+    size_t first = 0;
+    if (!lines.empty() && lines[0].compare(0, 2, "G|") == 0) {
+        parseNumber(string_view(lines[0]).substr(2), journalGeneration);
+        first = 1;
+    }
+    // The manifest already holds the changes of older generations
+    if (journalGeneration < generation) {
+        return false;
+    }
+
+    size_t replayed = first;
+    LogAction action;
+    while (replayed < lines.size() && parseRecord(lines[replayed], action) && apply(action)) {
+        ++replayed;
+    }
+    if (replayed < lines.size()) {
+        cerr << "Ignoring " << lines.size() - replayed << " unreadable journal record(s) in "
+             << filename << endl;
+        return false;
+    }
+    // Journals without a header predate generations and are replaced
+    return first == 1 && journalGeneration == generation;
+}
+
+void LogManager::bindFoods(const FoodList& foodList) {
+    // The log files only record names; look each one up once after loading,
+    // or once a partition loads later
+    boundFoods = &foodList;
+    for (auto& partition : partitions) {
+        LogColumns& entries = partition.second.entries;
+        for (size_t row = 0; row < entries.size(); ++row) {
+            if (entries.food(row) == noFood) {
+                entries.setFood(row, foodList.idOf(entries.foodName(row)));
+            }
         }
     }
-    
-    inFile.close();
-}
\ No newline at end of file
+}
@@ -3,31 +3,250 @@
 
 #include <bits/stdc++.h>
 #include "../food/food.h"
+#include "journal.h"
+#include "daytotals.h"
+#include "../rcu/rcu.h"
 using namespace std;
 
 struct LogEntry {
-    string foodName;
+    FoodId food = noFood; // unresolved until bound to the loaded FoodList
+    Symbol foodName;
     int servings;
     time_t date;
     int calories;
+    int day; // local calendar day of date, see LogManager::localDay
 };
 
+// Entries of one partition stored column by column, in date order, so a
+// search by date or day or a sum of calories reads one dense array instead
+// of whole entries
+class LogColumns {
+public:
+    size_t size() const { return dates.size(); }
+    bool empty() const { return dates.empty(); }
+    LogEntry entry(size_t row) const;
+    time_t date(size_t row) const { return dates[row]; }
+    int day(size_t row) const { return days[row]; }
+    int calories(size_t row) const { return calorieValues[row]; }
+    int servings(size_t row) const { return servingValues[row]; }
+    FoodId food(size_t row) const { return foods[row]; }
+    Symbol foodName(size_t row) const { return foodNames[row]; }
+    void setFood(size_t row, FoodId food) { foods[row] = food; }
+    const int32_t* dayColumn() const { return days.data(); }
+    const int32_t* calorieColumn() const { return calorieValues.data(); }
+    const Symbol* nameColumn() const { return foodNames.data(); }
+
+    // Row where an entry dated date goes, after any of the same second
+    size_t insertionRow(time_t date) const;
+    // Rows [first, last) logged from firstDay to lastDay
+    void dayRows(int firstDay, int lastDay, size_t& first, size_t& last) const;
+
+    void reserve(size_t rows);
+    void append(const LogEntry& entry);
+    void insert(size_t row, const LogEntry& entry);
+    void erase(size_t row);
+    // Empties the columns and returns their memory
+    void release();
+
+private:
+    vector<int64_t> dates;
+    vector<int32_t> days;
+    vector<int32_t> calorieValues;
+    vector<int32_t> servingValues;
+    vector<FoodId> foods;
+    vector<Symbol> foodNames;
+};
+
+// One applied change to the log; undo applies its inverse, redo applies it again
+struct LogAction {
+    enum Kind { Insert, Erase };
+    Kind kind;
+    int index;
+    LogEntry entry;
+};
+
+// Immutable version of the log's day totals for reader threads. LogManager
+// keeps a working copy, applies each change to it and publishes a copy,
+// which shares everything the change did not touch with the versions around
+// it. Entries are not included, since most months stay on disk.
+class LogView {
+public:
+    int getTotalCalories(time_t date) const;
+    long getTotalCalories(time_t from, time_t to) const;
+    int getLoggedDays(time_t from, time_t to) const;
+    double getAverageCalories(time_t from, time_t to) const;
+
+    // Writer side, used by LogManager
+    void setDay(int day, long calories, int entryCount);
+
+private:
+    struct DayTotal {
+        long calories = 0;
+        int entries = 0;
+    };
+    // Totals of each day from firstDay on, and of each block of blockDays of
+    // them, so a range costs at most two partial blocks plus one sum per block
+    static const int blockDays = 256;
+    int firstDay = 0;
+    PersistentVector<DayTotal> days;
+    vector<long> blockCalories;
+    vector<int> blockLoggedDays;
+    long calories(int from, int to) const;
+    int loggedDays(int from, int to) const;
+};
+
+struct CalorieReport;
+
+// The log is kept in date order and split by local month into partitions.
+// Startup reads data/log/manifest.txt, which lists every partition's file and
+// entry count along with the totals of every logged day, and loads only the
+// recent months; older ones load when an edit or viewLog reaches them.
+// Entry numbers (the index of LogAction and of the journal records) count
+// across all partitions in date order.
 class LogManager {
 public:
-    void displayOptions(const FoodList& foodList);
-    void addEntry(const string& foodName, int servings, int calories, time_t date = 0);
-    void deleteEntry(int index);
-    void undo();
-    void saveToFile(const string& filename);
+    void displayOptions(FoodList& foodList);
+    void addEntry(FoodId food, Symbol foodName, int servings, int calories, time_t date);
+    bool deleteEntry(int index);
+    bool undo();
+    bool redo();
+    // Writes the changed partitions and a new manifest, and starts a new
+    // journal generation
+    void checkpoint();
+    // Syncs the journal and checkpoints once it has grown long; for autosave
+    void flush();
+    // Called after every change. With a listener set, journal syncs and
+    // checkpoints are left to flush() instead of running inline.
+    void setChangeListener(function<void()> listener);
+    // Versions of the day totals for reader threads. The first call publishes
+    // the current totals; from then on every change publishes a new version.
+    const Published<LogView>& view();
     void loadFromFile();
-    void viewLog(time_t date = 0) const;
+    void bindFoods(const FoodList& foodList);
+    void viewLog(time_t date = 0);
+    // Loads the months from `from` to `to` and hands visit the rows of each
+    // logged on those days, month by month. Runs under the state lock, so
+    // visit must not call back into the log.
+    void scanEntries(time_t from, time_t to, const function<void(const LogColumns&, size_t, size_t)>& visit);
     int getTotalCalories(time_t date) const;
-    
+    // Totals over the local days from `from` to `to`, both included
+    long getTotalCalories(time_t from, time_t to) const;
+    int getLoggedDays(time_t from, time_t to) const;
+    double getAverageCalories(time_t from, time_t to) const;
+    int entryCount() const { return totalEntries; }
+    // Entries of the partitions currently in memory
+    int residentEntryCount() const { return residentEntries; }
+    static int localDay(time_t date);
+    // Months since January 1970 of date's local calendar month
+    static int localMonth(time_t date);
+    // Dates the log accepts, 1900-01-01 up to the end of 2199 (UTC)
+    static constexpr time_t earliestDate = -2208988800;
+    static constexpr time_t latestDate = 7258118399;
+
 private:
-    vector<LogEntry> entries;
-    string logFile = "data/log.txt";
-    vector<vector<LogEntry>> undoStack;
-    void saveState();
+    struct Partition {
+        int count = 0;
+        bool loaded = false;
+        // Bumped by every change; the partition is dirty until a checkpoint
+        // writes this version
+        uint64_t version = 0;
+        uint64_t writtenVersion = 0;
+        // Name in logDir as of the last checkpoint, empty if never written
+        string file;
+        LogColumns entries; // once loaded
+    };
+    // One partition file a checkpoint writes, or an emptied partition whose
+    // file it drops when file is empty
+    struct PartitionFile {
+        int month;
+        int count;
+        string file;
+        uint64_t version;
+        LogColumns entries;
+        // File of a month being sealed that was not loaded; its entries are
+        // read once stateLock is released
+        string source;
+    };
+    // Everything one checkpoint writes, kept for a retry if writing fails
+    struct LogSnapshot {
+        int generation = 0;
+        vector<PartitionFile> partitions;
+        // Manifest lines: each partition's by month, then the day totals
+        map<int, string> partitionLines;
+        string dayLines;
+        vector<string> obsoleteFiles;
+        string manifest() const;
+    };
+
+    map<int, Partition> partitions; // by month, see localMonth
+    int totalEntries = 0;
+    int residentEntries = 0;
+    // Per-day calorie sums for range reports, over every partition
+    DayTotals dayTotals;
+    // Months from the current one back that load at startup; partitions
+    // before them are written compressed
+    static const int recentMonths = 2;
+    string logDir = "data/log";
+    string manifestFile = "data/log/manifest.txt";
+    // Single-file log of older versions, read once and split into partitions
+    string legacyLogFile = "data/log.txt";
+    string journalFile = "data/log.journal";
+    // A checkpoint renames the journal here until the new manifest is written
+    string oldJournalFile = "data/log.journal.old";
+    // Every change since the last manifest, replayed on load
+    Journal journal;
+    // Journals start with a "G|n" record and the manifest with
+    // "#generation n"; the manifest includes every journal of a lower
+    // generation
+    int generation = 0;
+    // Held while partitions change or load and while a checkpoint copies
+    // them, so checkpoints can run on another thread; the menu thread reads
+    // without it
+    mutable mutex stateLock;
+    mutex saveLock;
+    function<void()> changeListener;
+    const FoodList* boundFoods = nullptr;
+    // Working copy of the next view and the days changed since the last one
+    // was published; only kept up once view() was called
+    Published<LogView> publishedView;
+    LogView viewDraft;
+    bool publishing = false;
+    vector<int> unpublishedDays;
+    // Set when a checkpoint could not write its files; retried by the next one
+    LogSnapshot pendingSnapshot;
+    bool snapshotPending = false;
+    static constexpr int checkpointInterval = 1000;
+    // Ring of the last historyCapacity actions; the first historyCursor of them
+    // (counting from historyStart) are undoable, the rest are redoable
+    static const int historyCapacity = 50;
+    vector<LogAction> history = vector<LogAction>(historyCapacity);
+    int historyStart = 0;
+    int historySize = 0;
+    int historyCursor = 0;
+    void recordAction(const LogAction& action);
+    bool applyAction(const LogAction& action, bool inverse);
+    bool replayJournal(const string& filename, int& records, int& journalGeneration,
+                       const function<bool(const LogAction&)>& apply);
+    bool replayAction(const LogAction& action);
+    bool checkpointDue() const;
+    LogSnapshot takeSnapshot(int snapshotGeneration) const;
+    void readSealing(LogSnapshot& snapshot) const;
+    bool writeSnapshot(const LogSnapshot& snapshot) const;
+    void commitSnapshot(const LogSnapshot& snapshot);
+    bool readManifest();
+    void readLegacyLog(vector<LogEntry>& entries);
+    void removeStaleFiles() const;
+    bool readPartition(const string& file, LogColumns& entries) const;
+    Partition& loadPartition(int month);
+    int entriesBefore(int month) const;
+    int partitionOf(int index, int& offset) const;
+    bool insertEntry(int index, const LogEntry& entry);
+    bool eraseEntry(int index);
+    void republishView();
+    void publishView();
+    void reportOptions();
+    void printReport(time_t from, time_t to) const;
+    void printGroupReport(const CalorieReport& report, int grouping) const;
 };
 
-#endif // LOG_H
\ No newline at end of file
+#endif // LOG_H
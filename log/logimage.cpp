@@ -0,0 +1,140 @@
+#include "logimage.h"
+#include "log.h"
+#include "../io/files.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static const char imageMagic[8] = {'Y', 'A', 'D', 'A', 'L', 'O', 'G', '\0'};
+
+template <typename T>
+static void appendArray(string& out, const vector<T>& values) {
+    out.append(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(T));
+}
+
+LogImage::~LogImage() {
+    close();
+}
+
+bool LogImage::write(const string& filename, const LogColumns& entries, int generation) {
+    // Each distinct food name is stored once and records refer to it by position
+    string heap;
+    vector<NameRecord> nameRecords;
+    unordered_map<Symbol, uint32_t> namePositions;
+    vector<EntryRecord> entryRecords;
+    entryRecords.reserve(entries.size());
+    for (size_t row = 0; row < entries.size(); ++row) {
+        auto inserted = namePositions.emplace(entries.foodName(row), nameRecords.size());
+        if (inserted.second) {
+            string_view name = symbols().text(entries.foodName(row));
+            nameRecords.push_back({static_cast<uint32_t>(heap.size()), static_cast<uint32_t>(name.size())});
+            heap += name;
+        }
+        entryRecords.push_back({static_cast<int64_t>(entries.date(row)), inserted.first->second,
+                                entries.servings(row), entries.calories(row), 0});
+    }
+
+    string body;
+    appendArray(body, entryRecords);
+    appendArray(body, nameRecords);
+    body += heap;
+
+    Header header = {};
+    memcpy(header.magic, imageMagic, sizeof(header.magic));
+    header.version = version;
+    header.entryCount = entryRecords.size();
+    header.nameCount = nameRecords.size();
+    header.stringHeapSize = heap.size();
+    header.generation = generation;
+    header.checksum = checksumOf(body);
+
+    string contents(reinterpret_cast<const char*>(&header), sizeof(header));
+    contents += body;
+    return writeFileAtomically(filename, contents);
+}
+
+bool LogImage::open(const string& filename) {
+    close();
+
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size < static_cast<off_t>(sizeof(Header))) {
+        ::close(fd);
+        return false;
+    }
+
+    void* mapped = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (mapped == MAP_FAILED) return false;
+
+    data = static_cast<const char*>(mapped);
+    length = info.st_size;
+    header = reinterpret_cast<const Header*>(data);
+
+    if (memcmp(header->magic, imageMagic, sizeof(imageMagic)) != 0 || header->version != version) {
+        close();
+        return false;
+    }
+
+    uint64_t expected = sizeof(Header) + uint64_t(header->entryCount) * sizeof(EntryRecord) +
+                        uint64_t(header->nameCount) * sizeof(NameRecord) + header->stringHeapSize;
+    if (expected != length) {
+        close();
+        return false;
+    }
+
+    const char* cursor = data + sizeof(Header);
+    records = reinterpret_cast<const EntryRecord*>(cursor);
+    cursor += header->entryCount * sizeof(EntryRecord);
+    names = reinterpret_cast<const NameRecord*>(cursor);
+    cursor += header->nameCount * sizeof(NameRecord);
+    strings = cursor;
+    return true;
+}
+
+void LogImage::close() {
+    if (data) {
+        munmap(const_cast<char*>(data), length);
+    }
+    data = nullptr;
+    length = 0;
+    header = nullptr;
+}
+
+bool LogImage::verify() const {
+    if (!header || checksumOf(string_view(data + sizeof(Header), length - sizeof(Header))) != header->checksum) {
+        return false;
+    }
+    // Name positions are followed blindly by the accessors
+    for (uint32_t i = 0; i < header->entryCount; ++i) {
+        if (records[i].name >= header->nameCount) return false;
+    }
+    for (uint32_t i = 0; i < header->nameCount; ++i) {
+        if (uint64_t(names[i].offset) + names[i].length > header->stringHeapSize) return false;
+    }
+    return true;
+}
+
+uint32_t LogImage::entryCount() const {
+    return header ? header->entryCount : 0;
+}
+
+string_view LogImage::entryFoodName(uint32_t entry) const {
+    const NameRecord& name = names[records[entry].name];
+    return string_view(strings + name.offset, name.length);
+}
+
+int LogImage::entryServings(uint32_t entry) const {
+    return records[entry].servings;
+}
+
+int LogImage::entryCalories(uint32_t entry) const {
+    return records[entry].calories;
+}
+
+time_t LogImage::entryDate(uint32_t entry) const {
+    return records[entry].date;
+}
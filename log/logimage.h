@@ -0,0 +1,69 @@
+#ifndef LOGIMAGE_H
+#define LOGIMAGE_H
+
+#include <bits/stdc++.h>
+using namespace std;
+
+class LogColumns;
+
+// Versioned binary file holding one recent month of the log; older months
+// are stored compressed as a SealedPartition instead. After a fixed header
+// come fixed-width entry records in date order, then the food name table and
+// a heap with its text. The file is mapped read-only and loaded into
+// LogColumns, which answer the month's queries. The checksum covers
+// everything after the header; it is checked by verify() rather than on
+// open, which would read the whole file.
+class LogImage {
+public:
+    static const uint32_t version = 3;
+
+    LogImage() = default;
+    LogImage(const LogImage&) = delete;
+    LogImage& operator=(const LogImage&) = delete;
+    ~LogImage();
+
+    static bool write(const string& filename, const LogColumns& entries, int generation);
+    bool open(const string& filename);
+    void close();
+    bool isOpen() const { return header != nullptr; }
+    bool verify() const;
+
+    uint32_t entryCount() const;
+    string_view entryFoodName(uint32_t entry) const;
+    int entryServings(uint32_t entry) const;
+    int entryCalories(uint32_t entry) const;
+    time_t entryDate(uint32_t entry) const;
+
+private:
+    struct Header {
+        char magic[8];
+        uint32_t version;
+        uint32_t entryCount;
+        uint32_t nameCount;
+        uint32_t stringHeapSize;
+        int64_t generation;
+        uint64_t checksum;
+    };
+
+    struct EntryRecord {
+        int64_t date;
+        uint32_t name; // position in the name table
+        int32_t servings;
+        int32_t calories;
+        uint32_t reserved;
+    };
+
+    struct NameRecord {
+        uint32_t offset;
+        uint32_t length;
+    };
+
+    const char* data = nullptr;
+    size_t length = 0;
+    const Header* header = nullptr;
+    const EntryRecord* records = nullptr;
+    const NameRecord* names = nullptr;
+    const char* strings = nullptr;
+};
+
+#endif // LOGIMAGE_H
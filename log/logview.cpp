@@ -0,0 +1,85 @@
+#include "log.h"
+
+int LogView::getTotalCalories(time_t date) const {
+    int day = LogManager::localDay(date) - firstDay;
+    return day >= 0 && day < static_cast<int>(days.size()) ? days[day].calories : 0;
+}
+
+long LogView::getTotalCalories(time_t from, time_t to) const {
+    return calories(LogManager::localDay(from) - firstDay, LogManager::localDay(to) - firstDay);
+}
+
+int LogView::getLoggedDays(time_t from, time_t to) const {
+    return loggedDays(LogManager::localDay(from) - firstDay, LogManager::localDay(to) - firstDay);
+}
+
+double LogView::getAverageCalories(time_t from, time_t to) const {
+    int logged = getLoggedDays(from, to);
+    return logged == 0 ? 0.0 : static_cast<double>(getTotalCalories(from, to)) / logged;
+}
+
+// from and to are offsets from firstDay, both included
+long LogView::calories(int from, int to) const {
+    from = max(from, 0);
+    to = min(to, static_cast<int>(days.size()) - 1);
+    long sum = 0;
+    while (from <= to) {
+        if (from % blockDays == 0 && from + blockDays - 1 <= to) {
+            sum += blockCalories[from / blockDays];
+            from += blockDays;
+        } else {
+            sum += days[from++].calories;
+        }
+    }
+    return sum;
+}
+
+int LogView::loggedDays(int from, int to) const {
+    from = max(from, 0);
+    to = min(to, static_cast<int>(days.size()) - 1);
+    int count = 0;
+    while (from <= to) {
+        if (from % blockDays == 0 && from + blockDays - 1 <= to) {
+            count += blockLoggedDays[from / blockDays];
+            from += blockDays;
+        } else {
+            count += days[from++].entries > 0;
+        }
+    }
+    return count;
+}
+
+void LogView::setDay(int day, long calories, int entryCount) {
+    if (days.empty()) {
+        firstDay = day;
+    }
+    if (day < firstDay) {
+        // Rebuild starting from the earlier day; days only move back rarely
+        PersistentVector<DayTotal> old;
+        swap(old, days);
+        size_t shift = firstDay - day;
+        size_t count = shift + old.size();
+        firstDay = day;
+        blockCalories.assign((count + blockDays - 1) / blockDays, 0);
+        blockLoggedDays.assign((count + blockDays - 1) / blockDays, 0);
+        for (size_t i = 0; i < count; ++i) {
+            DayTotal total = i < shift ? DayTotal() : old[i - shift];
+            days.push_back(total);
+            blockCalories[i / blockDays] += total.calories;
+            blockLoggedDays[i / blockDays] += total.entries > 0;
+        }
+    }
+
+    size_t offset = day - firstDay;
+    while (days.size() <= offset) {
+        days.push_back(DayTotal());
+    }
+    if (blockCalories.size() <= offset / blockDays) {
+        blockCalories.resize(offset / blockDays + 1);
+        blockLoggedDays.resize(offset / blockDays + 1);
+    }
+    DayTotal previous = days[offset];
+    blockCalories[offset / blockDays] += calories - previous.calories;
+    blockLoggedDays[offset / blockDays] += (entryCount > 0) - (previous.entries > 0);
+    days.set(offset, {calories, entryCount});
+}
@@ -0,0 +1,110 @@
+#include "partition.h"
+#include "log.h"
+#include "../io/files.h"
+#include "../io/lines.h"
+
+static const char partitionMagic[8] = {'Y', 'A', 'D', 'A', 'L', 'O', 'G', 'Z'};
+
+static void putVarint(string& out, uint64_t value) {
+    while (value >= 0x80) {
+        out += static_cast<char>(value | 0x80);
+        value >>= 7;
+    }
+    out += static_cast<char>(value);
+}
+
+static uint64_t zigzag(int64_t value) {
+    return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+}
+
+static int64_t unzigzag(uint64_t value) {
+    return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+}
+
+// Reads a varint at cursor, stopping at end; false if it runs past end
+static bool getVarint(const char*& cursor, const char* end, uint64_t& value) {
+    value = 0;
+    for (int shift = 0; cursor < end && shift < 64; shift += 7) {
+        unsigned char byte = *cursor++;
+        value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) return true;
+    }
+    return false;
+}
+
+bool SealedPartition::write(const string& filename, const LogColumns& entries) {
+    string names;
+    string records;
+    unordered_map<Symbol, uint32_t> namePositions;
+    int64_t previous = 0;
+    for (size_t row = 0; row < entries.size(); ++row) {
+        auto inserted = namePositions.emplace(entries.foodName(row), namePositions.size());
+        if (inserted.second) {
+            string_view name = symbols().text(entries.foodName(row));
+            putVarint(names, name.size());
+            names += name;
+        }
+        putVarint(records, zigzag(static_cast<int64_t>(entries.date(row)) - previous));
+        previous = entries.date(row);
+        putVarint(records, inserted.first->second);
+        putVarint(records, zigzag(entries.servings(row)));
+        putVarint(records, zigzag(entries.calories(row)));
+    }
+
+    Header header = {};
+    memcpy(header.magic, partitionMagic, sizeof(header.magic));
+    header.version = version;
+    header.entryCount = entries.size();
+    header.nameCount = namePositions.size();
+    string body = names + records;
+    header.checksum = checksumOf(body);
+
+    string contents(reinterpret_cast<const char*>(&header), sizeof(header));
+    contents += body;
+    return writeFileAtomically(filename, contents);
+}
+
+bool SealedPartition::read(const string& filename, LogColumns& entries) {
+    entries.release();
+    MappedFile file;
+    if (!file.open(filename)) return false;
+    string_view contents = file.text();
+    if (contents.size() < sizeof(Header)) return false;
+
+    Header header;
+    memcpy(&header, contents.data(), sizeof(header));
+    string_view body = contents.substr(sizeof(header));
+    if (memcmp(header.magic, partitionMagic, sizeof(partitionMagic)) != 0 || header.version != version ||
+        checksumOf(body) != header.checksum) {
+        return false;
+    }
+
+    const char* cursor = body.data();
+    const char* end = body.data() + body.size();
+    vector<Symbol> names(header.nameCount);
+    for (auto& name : names) {
+        uint64_t length;
+        if (!getVarint(cursor, end, length) || length > static_cast<uint64_t>(end - cursor)) return false;
+        name = symbols().intern(string_view(cursor, length));
+        cursor += length;
+    }
+
+    entries.reserve(header.entryCount);
+    int64_t date = 0;
+    for (uint32_t i = 0; i < header.entryCount; ++i) {
+        uint64_t delta, name, servings, calories;
+        if (!getVarint(cursor, end, delta) || !getVarint(cursor, end, name) || !getVarint(cursor, end, servings) ||
+            !getVarint(cursor, end, calories) || name >= names.size()) {
+            return false;
+        }
+        date += unzigzag(delta);
+        LogEntry entry;
+        entry.foodName = names[name];
+        entry.servings = unzigzag(servings);
+        entry.calories = unzigzag(calories);
+        entry.date = date;
+        entry.day = LogManager::localDay(entry.date);
+        entries.append(entry);
+    }
+    return cursor == end;
+}
@@ -0,0 +1,34 @@
+#ifndef PARTITION_H
+#define PARTITION_H
+
+#include <bits/stdc++.h>
+using namespace std;
+
+class LogColumns;
+
+// Compressed file holding one sealed month of the log, which is only read
+// when a query reaches back into it. After a fixed header come the distinct
+// food names, each as a varint length and its bytes, then one record per
+// entry in log order: the seconds since the previous entry's date, the
+// position of its name, its servings and its calories, each a varint
+// (zigzag-encoded where it can be negative).
+class SealedPartition {
+public:
+    static const uint32_t version = 1;
+
+    static bool write(const string& filename, const LogColumns& entries);
+    // Replaces entries with the file's; false if it is missing or damaged
+    static bool read(const string& filename, LogColumns& entries);
+
+private:
+    struct Header {
+        char magic[8];
+        uint32_t version;
+        uint32_t entryCount;
+        uint32_t nameCount;
+        uint32_t reserved;
+        uint64_t checksum;
+    };
+};
+
+#endif // PARTITION_H
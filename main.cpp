@@ -2,22 +2,189 @@
 #include "food/food.h"
 #include "log/log.h"
 #include "profile/profile.h"
+#include "batch/batch.h"
+#include "metrics/metrics.h"
+#include "autosave/autosave.h"
+#include "server/server.h"
+#include "io/lines.h"
 #include <filesystem>
 
 using namespace std;
 
-int main() {
+static void displayMetricsOptions() {
+    while (true) {
+        cout << "\nMetrics Options:\n";
+        cout << "1. View operation latencies\n";
+        cout << "2. Export metrics (Prometheus text)\n";
+        cout << "3. Return to main menu\n";
+        cout << "Enter choice: ";
+
+        int choice;
+        cin >> choice;
+        if (cin.fail() && cin.eof()) return;
+        if (cin.fail()) {
+            cin.clear();
+            cin.ignore(numeric_limits<streamsize>::max(), '\n');
+            cout << "Invalid input. Try again.\n";
+            continue;
+        }
+
+        switch (choice) {
+            case 1:
+                cout << "\n";
+                metrics().printSummary(cout);
+                break;
+            case 2: {
+                ofstream outFile("data/metrics.prom");
+                if (!outFile) {
+                    cerr << "Error opening file for writing: data/metrics.prom" << endl;
+                    break;
+                }
+                metrics().writePrometheus(outFile);
+                cout << "Metrics written to data/metrics.prom\n";
+                break;
+            }
+            case 3:
+                return;
+            default:
+                cout << "Invalid choice. Try again.\n";
+        }
+    }
+}
+
+// Has the saver write whatever the stores change, once it is started
+static void autosaveChanges(AutoSaver& autoSaver, FoodList& foodList, LogManager& logManager, DietProfile& profile) {
+    autoSaver.watch([&] { foodList.saveToFiles(); });
+    autoSaver.watch([&] { logManager.flush(); });
+    autoSaver.watch([&] { profile.saveToFile(); });
+    foodList.setChangeListener([&] { autoSaver.notify(); });
+    logManager.setChangeListener([&] { autoSaver.notify(); });
+    profile.setChangeListener([&] { autoSaver.notify(); });
+}
+
+int main(int argc, char* argv[]) {
     FoodList foodList;
     LogManager logManager;
     DietProfile profile;
+
+    string batchFile, recordFile, replayFile, serveAddress;
+    long autosaveMs = 2000;
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg == "--batch" && i + 1 < argc) batchFile = argv[++i];
+        else if (arg == "--record" && i + 1 < argc) recordFile = argv[++i];
+        else if (arg == "--replay" && i + 1 < argc) replayFile = argv[++i];
+        else if (arg == "--serve" && i + 1 < argc) serveAddress = argv[++i];
+        else if (arg == "--autosave-ms" && i + 1 < argc && parseNumber(argv[i + 1], autosaveMs)) ++i;
+        else {
+            cerr << "Usage: " << argv[0]
+                 << " [--batch <file|->] [--record <file>] [--replay <file>] [--autosave-ms <ms>]"
+                 << " [--serve <socket-path|tcp:port>]\n";
+            return 1;
+        }
+    }
     
     // Create data directory if it doesn't exist
     filesystem::create_directory("data");
     
-    // Load data
-    foodList.loadFromFiles();
+    // Load data. The three stores are independent until the log is bound
+    // to food ids, so they load side by side.
+    auto foodLoad = async(launch::async, [&] { foodList.loadFromFiles(); });
+    auto profileLoad = async(launch::async, [&] { return profile.loadFromFile(); });
     logManager.loadFromFile();
-    profile.loadFromFile();
+    foodLoad.get();
+    bool hasProfile = profileLoad.get();
+    logManager.bindFoods(foodList);
+
+    if (!batchFile.empty()) {
+        ios::sync_with_stdio(false);
+        ifstream commandFile;
+        if (batchFile != "-") {
+            commandFile.open(batchFile);
+            if (!commandFile) {
+                cerr << "Error opening batch file: " << batchFile << endl;
+                return 1;
+            }
+        }
+
+        BatchRunner runner(foodList, logManager, profile);
+        auto start = chrono::steady_clock::now();
+        runner.run(batchFile == "-" ? cin : commandFile, cout);
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        cout.flush();
+
+        foodList.saveToFiles();
+        logManager.checkpoint();
+        cerr << "Processed " << runner.commandCount() << " commands (" << runner.errorCount() << " failed) in "
+             << fixed << setprecision(3) << seconds << " s, "
+             << setprecision(0) << runner.commandCount() / max(seconds, 1e-9) << " commands/s\n";
+        return runner.errorCount() == 0 ? 0 : 2;
+    }
+
+    if (!serveAddress.empty()) {
+        BatchRunner runner(foodList, logManager, profile);
+        CommandServer server(runner);
+        // Listen before the saver thread starts, so it inherits the blocked stop signals
+        if (!server.listen(serveAddress)) {
+            return 1;
+        }
+        AutoSaver autoSaver{chrono::milliseconds(autosaveMs)};
+        autosaveChanges(autoSaver, foodList, logManager, profile);
+        autoSaver.start();
+        cerr << "Serving on " << serveAddress << "\n";
+        server.run();
+
+        autoSaver.stop();
+        foodList.saveToFiles();
+        logManager.checkpoint();
+        profile.saveToFile();
+        cerr << "Served " << runner.commandCount() << " requests\n";
+        return 0;
+    }
+
+    // A replayed session is fed to the menus before the live input, and a
+    // recording captures whatever the menus read, replayed part included
+    streambuf* liveInput = cin.rdbuf();
+    ifstream replayInput;
+    unique_ptr<ReplayStreambuf> replayBuffer;
+    if (!replayFile.empty()) {
+        replayInput.open(replayFile);
+        if (!replayInput) {
+            cerr << "Error opening replay file: " << replayFile << endl;
+            return 1;
+        }
+        replayBuffer = make_unique<ReplayStreambuf>(replayInput.rdbuf(), cin.rdbuf());
+        cin.rdbuf(replayBuffer.get());
+    }
+    ofstream recording;
+    unique_ptr<RecordingStreambuf> recordBuffer;
+    if (!recordFile.empty()) {
+        recording.open(recordFile);
+        if (!recording) {
+            cerr << "Error opening record file: " << recordFile << endl;
+            return 1;
+        }
+        recordBuffer = make_unique<RecordingStreambuf>(cin.rdbuf(), recording);
+        cin.rdbuf(recordBuffer.get());
+    }
+    // Hand cin its own buffer back before the ones above are destroyed
+    struct InputRestorer {
+        streambuf* buffer;
+        ~InputRestorer() { cin.rdbuf(buffer); }
+    } restoreInput{liveInput};
+
+    // Changes made in the menus are written in the background, at most
+    // autosaveMs after they happen; a burst of changes is written once
+    AutoSaver autoSaver{chrono::milliseconds(autosaveMs)};
+    autosaveChanges(autoSaver, foodList, logManager, profile);
+    autoSaver.start();
+
+    if (hasProfile) {
+        cout << "Profile loaded successfully.\n";
+    } else {
+        cout << "No profile found. Please create a new profile.\n";
+        profile.updateProfile();
+    }
     
     while (true) {
         cout << "\nMain Menu:\n";
@@ -25,12 +192,15 @@ int main() {
         cout << "2. Food Log\n";
         cout << "3. Diet Profile\n";
         cout << "4. View Daily Summary\n";
-        cout << "5. Exit\n";
+        cout << "5. Metrics\n";
+        cout << "6. Exit\n";
         cout << "Enter choice: ";
         
         int choice;
         cin >> choice;
-        if (cin.fail()) {
+        // Input ran out: leave as if Exit had been chosen
+        if (cin.fail() && cin.eof()) choice = 6;
+        else if (cin.fail()) {
             cin.clear();
             cin.ignore(numeric_limits<streamsize>::max(), '\n');
             cout << "Invalid input. Try again.\n";
@@ -50,7 +220,7 @@ int main() {
             case 4: {
                 time_t today = time(nullptr);
                 int totalCalories = logManager.getTotalCalories(today);
-                int targetCalories = profile.calculateTargetCalories();
+                int targetCalories = profile.calculateTargetCalories(DietProfile::promptEquation());
                 int difference = totalCalories - targetCalories;
                 
                 char buffer[80];
@@ -64,9 +234,14 @@ int main() {
                 break;
             }
             case 5:
+                displayMetricsOptions();
+                break;
+            case 6:
                 // Save data
+                autoSaver.stop();
                 foodList.saveToFiles();
-                logManager.saveToFile("data/log.txt");
+                logManager.checkpoint();
+                profile.saveToFile();
                 cout << "Data saved. Goodbye!\n";
                 return 0;
             default:
@@ -0,0 +1,80 @@
+#include "metrics.h"
+
+uint64_t Histogram::percentile(double p) const {
+    uint64_t target = ceil(total() * p);
+    uint64_t seen = 0;
+    for (int b = 0; b < bucketCount; ++b) {
+        seen += bucket(b);
+        if (seen >= target && seen > 0) {
+            // Upper edge of the bucket, so the estimate errs on the slow side
+            return (uint64_t(1) << (b + 1)) - 1;
+        }
+    }
+    return 0;
+}
+
+Counter& MetricsRegistry::counter(const string& name) {
+    lock_guard<mutex> guard(lock);
+    auto& slot = counters[name];
+    if (!slot) slot = make_unique<Counter>();
+    return *slot;
+}
+
+Histogram& MetricsRegistry::histogram(const string& name) {
+    lock_guard<mutex> guard(lock);
+    auto& slot = histograms[name];
+    if (!slot) slot = make_unique<Histogram>();
+    return *slot;
+}
+
+void MetricsRegistry::printSummary(ostream& out) const {
+    lock_guard<mutex> guard(lock);
+    if (counters.empty() && histograms.empty()) {
+        out << "No metrics recorded.\n";
+        return;
+    }
+
+    out << left << setw(28) << "Operation" << right << setw(10) << "Count" << setw(12) << "Mean us"
+        << setw(12) << "p50 us" << setw(12) << "p99 us" << "\n";
+    out << fixed << setprecision(1);
+    for (const auto& entry : histograms) {
+        const Histogram& histogram = *entry.second;
+        uint64_t count = histogram.total();
+        out << left << setw(28) << entry.first << right << setw(10) << count
+            << setw(12) << (count ? histogram.totalNanos() / 1e3 / count : 0.0)
+            << setw(12) << histogram.percentile(0.5) / 1e3 << setw(12) << histogram.percentile(0.99) / 1e3 << "\n";
+    }
+    for (const auto& entry : counters) {
+        out << left << setw(28) << entry.first << right << setw(10) << entry.second->get() << "\n";
+    }
+    out << defaultfloat << left;
+}
+
+void MetricsRegistry::writePrometheus(ostream& out) const {
+    lock_guard<mutex> guard(lock);
+    for (const auto& entry : counters) {
+        string name = "yada_" + entry.first + "_total";
+        out << "# TYPE " << name << " counter\n" << name << " " << entry.second->get() << "\n";
+    }
+    for (const auto& entry : histograms) {
+        const Histogram& histogram = *entry.second;
+        string name = "yada_" + entry.first + "_seconds";
+        out << "# TYPE " << name << " histogram\n";
+
+        int last = Histogram::bucketCount - 1;
+        while (last > 0 && histogram.bucket(last) == 0) --last;
+        uint64_t cumulative = 0;
+        for (int b = 0; b <= last && b < Histogram::bucketCount - 1; ++b) {
+            cumulative += histogram.bucket(b);
+            out << name << "_bucket{le=\"" << double(uint64_t(1) << (b + 1)) / 1e9 << "\"} " << cumulative << "\n";
+        }
+        out << name << "_bucket{le=\"+Inf\"} " << histogram.total() << "\n";
+        out << name << "_sum " << histogram.totalNanos() / 1e9 << "\n";
+        out << name << "_count " << histogram.total() << "\n";
+    }
+}
+
+MetricsRegistry& metrics() {
+    static MetricsRegistry registry;
+    return registry;
+}
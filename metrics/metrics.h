@@ -0,0 +1,88 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <bits/stdc++.h>
+using namespace std;
+
+// Monotonic event counter
+class Counter {
+public:
+    void add(uint64_t n = 1) { value.fetch_add(n, memory_order_relaxed); }
+    uint64_t get() const { return value.load(memory_order_relaxed); }
+
+private:
+    atomic<uint64_t> value{0};
+};
+
+// Latency histogram with power-of-two buckets: bucket b counts durations in
+// [2^b, 2^(b+1)) nanoseconds, the last bucket everything longer
+class Histogram {
+public:
+    static const int bucketCount = 40;
+
+    void record(uint64_t nanos) {
+        int bucket = nanos == 0 ? 0 : min(63 - __builtin_clzll(nanos), bucketCount - 1);
+        buckets[bucket].fetch_add(1, memory_order_relaxed);
+        count.fetch_add(1, memory_order_relaxed);
+        sum.fetch_add(nanos, memory_order_relaxed);
+    }
+    uint64_t bucket(int b) const { return buckets[b].load(memory_order_relaxed); }
+    uint64_t total() const { return count.load(memory_order_relaxed); }
+    uint64_t totalNanos() const { return sum.load(memory_order_relaxed); }
+    uint64_t percentile(double p) const;
+
+private:
+    array<atomic<uint64_t>, bucketCount> buckets{};
+    atomic<uint64_t> count{0};
+    atomic<uint64_t> sum{0};
+};
+
+// Process-wide set of named counters and histograms. Lookups by name take a
+// lock, so instrumented code resolves each metric once and keeps the reference.
+class MetricsRegistry {
+public:
+    Counter& counter(const string& name);
+    Histogram& histogram(const string& name);
+    void printSummary(ostream& out) const;
+    void writePrometheus(ostream& out) const;
+
+private:
+    mutable mutex lock;
+    map<string, unique_ptr<Counter>> counters;
+    map<string, unique_ptr<Histogram>> histograms;
+};
+
+MetricsRegistry& metrics();
+
+// Records the time from construction to destruction into a histogram
+class ScopedTimer {
+public:
+    explicit ScopedTimer(Histogram& histogram) : histogram(histogram), start(chrono::steady_clock::now()) {}
+    ~ScopedTimer() {
+        histogram.record(chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count());
+    }
+
+private:
+    Histogram& histogram;
+    chrono::steady_clock::time_point start;
+};
+
+// YADA_TIMED(name) times the rest of the enclosing scope and YADA_COUNT(name, n)
+// adds to a counter. Building with -DYADA_NO_METRICS compiles both out.
+#define YADA_METRIC_CONCAT_(a, b) a##b
+#define YADA_METRIC_CONCAT(a, b) YADA_METRIC_CONCAT_(a, b)
+#ifdef YADA_NO_METRICS
+#define YADA_TIMED(name) ((void)0)
+#define YADA_COUNT(name, n) ((void)0)
+#else
+#define YADA_TIMED(name)                                                                   \
+    static Histogram& YADA_METRIC_CONCAT(yadaHistogram, __LINE__) = metrics().histogram(name); \
+    ScopedTimer YADA_METRIC_CONCAT(yadaTimer, __LINE__)(YADA_METRIC_CONCAT(yadaHistogram, __LINE__))
+#define YADA_COUNT(name, n)                                                               \
+    do {                                                                                  \
+        static Counter& yadaCounter = metrics().counter(name);                            \
+        yadaCounter.add(n);                                                               \
+    } while (0)
+#endif
+
+#endif // METRICS_H
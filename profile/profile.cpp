@@ -1,4 +1,7 @@
 #include "profile.h"
+#include "../metrics/metrics.h"
+#include "../io/files.h"
+#include "../io/lines.h"
 #include <iostream>
 #include <fstream>
 #include <iomanip>
@@ -19,6 +22,7 @@ void DietProfile::displayOptions() {
         
         int choice;
         cin >> choice;
+        if (cin.fail() && cin.eof()) return;
         if (cin.fail()) {
             cin.clear();
             cin.ignore(numeric_limits<streamsize>::max(), '\n');
@@ -34,9 +38,11 @@ void DietProfile::displayOptions() {
             case 2:
                 updateProfile();
                 break;
-            case 3:
-                cout << "\nDaily Calorie Target: " << calculateTargetCalories() << " cal\n";
+            case 3: {
+                int target = calculateTargetCalories(promptEquation());
+                cout << "\nDaily Calorie Target: " << target << " cal\n";
                 break;
+            }
             case 4:
                 return;
             default:
@@ -45,7 +51,7 @@ void DietProfile::displayOptions() {
     }
 }
 
-int DietProfile::calculateTargetCalories() const {
+Equation DietProfile::promptEquation() {
     cout << "\nSelect Calorie Calculation Method:\n";
     cout << "1. Harris-Benedict Equation\n";
     cout << "2. Mifflin-St Jeor Equation\n";
@@ -54,51 +60,31 @@ int DietProfile::calculateTargetCalories() const {
 
     int method;
     cin >> method;
+    if (cin.fail()) {
+        cin.clear();
+        method = 0;
+    }
     cin.ignore(numeric_limits<streamsize>::max(), '\n');
 
-    double bmr = 0.0;
-
-    switch (method) {
-        case 1:
-            if (gender == "male") {
-                bmr = 88.362 + (13.397 * weight) + (4.799 * height) - (5.677 * age);
-            } else {
-                bmr = 447.593 + (9.247 * weight) + (3.098 * height) - (4.330 * age);
-            }
-            break;
-        case 2:
-            if (gender == "male") {
-                bmr = (10 * weight) + (6.25 * height) - (5 * age) + 5;
-            } else {
-                bmr = (10 * weight) + (6.25 * height) - (5 * age) - 161;
-            }
-            break;
-        case 3:
-            {
-                double leanMass = weight * 0.8;
-                bmr = 370 + (21.6 * leanMass);
-            }
-            break;
-        default:
-            cout << "Invalid choice. Using Harris-Benedict as default.\n";
-            if (gender == "male") {
-                bmr = 88.362 + (13.397 * weight) + (4.799 * height) - (5.677 * age);
-            } else {
-                bmr = 447.593 + (9.247 * weight) + (3.098 * height) - (4.330 * age);
-            }
+    if (method < 1 || method > 3) {
+        cout << "Invalid choice. Using Harris-Benedict as default.\n";
+        method = 1;
     }
+    return static_cast<Equation>(method - 1);
+}
 
-    double activityMultiplier = 1.2;
-    if (activityLevel == "light") activityMultiplier = 1.375;
-    else if (activityLevel == "moderate") activityMultiplier = 1.55;
-    else if (activityLevel == "active") activityMultiplier = 1.725;
-    else if (activityLevel == "very active") activityMultiplier = 1.9;
-
-    return static_cast<int>(bmr * activityMultiplier);
+int DietProfile::calculateTargetCalories(Equation equation) const {
+    return computeTargetCalories(sex, age, height, weight, activity, equation);
 }
 
 
 void DietProfile::updateProfile() {
+    // Read everything first so a save never sees a half-updated profile
+    Sex newSex;
+    int newAge;
+    double newHeight, newWeight;
+    ActivityLevel newActivity;
+
     while (true) {
         cout << "Select gender:\n";
         cout << "1. Male\n";
@@ -107,6 +93,7 @@ void DietProfile::updateProfile() {
         int genderChoice;
         cin >> genderChoice;
 
+        if (cin.fail() && cin.eof()) return;
         if (cin.fail() || (genderChoice != 1 && genderChoice != 2)) {
             cin.clear();
             cin.ignore(numeric_limits<streamsize>::max(), '\n');
@@ -114,16 +101,17 @@ void DietProfile::updateProfile() {
             continue;
         }
 
-        gender = (genderChoice == 1) ? "male" : "female";
+        newSex = (genderChoice == 1) ? Sex::Male : Sex::Female;
         cin.ignore(numeric_limits<streamsize>::max(), '\n');
         break;
     }
 
     while (true) {
         cout << "Enter age: ";
-        cin >> age;
+        cin >> newAge;
 
-        if (cin.fail() || age <= 0) {
+        if (cin.fail() && cin.eof()) return;
+        if (cin.fail() || newAge <= 0) {
             cin.clear();
             cin.ignore(numeric_limits<streamsize>::max(), '\n');
             cout << "Invalid input. Please enter a valid age.\n";
@@ -136,9 +124,10 @@ void DietProfile::updateProfile() {
 
     while (true) {
         cout << "Enter height (cm): ";
-        cin >> height;
+        cin >> newHeight;
 
-        if (cin.fail() || height <= 0) {
+        if (cin.fail() && cin.eof()) return;
+        if (cin.fail() || newHeight <= 0) {
             cin.clear();
             cin.ignore(numeric_limits<streamsize>::max(), '\n');
             cout << "Invalid input. Please enter a valid height.\n";
@@ -151,9 +140,10 @@ void DietProfile::updateProfile() {
 
     while (true) {
         cout << "Enter weight (kg): ";
-        cin >> weight;
+        cin >> newWeight;
 
-        if (cin.fail() || weight <= 0) {
+        if (cin.fail() && cin.eof()) return;
+        if (cin.fail() || newWeight <= 0) {
             cin.clear();
             cin.ignore(numeric_limits<streamsize>::max(), '\n');
             cout << "Invalid input. Please enter a valid weight.\n";
@@ -175,6 +165,7 @@ void DietProfile::updateProfile() {
         int activityChoice;
         cin >> activityChoice;
 
+        if (cin.fail() && cin.eof()) return;
         if (cin.fail() || activityChoice < 1 || activityChoice > 5) {
             cin.clear();
             cin.ignore(numeric_limits<streamsize>::max(), '\n');
@@ -182,65 +173,79 @@ void DietProfile::updateProfile() {
             continue;
         }
 
-        switch (activityChoice) {
-            case 1: activityLevel = "sedentary"; break;
-            case 2: activityLevel = "light"; break;
-            case 3: activityLevel = "moderate"; break;
-            case 4: activityLevel = "active"; break;
-            case 5: activityLevel = "very active"; break;
-        }
+        newActivity = static_cast<ActivityLevel>(activityChoice - 1);
 
         cin.ignore(numeric_limits<streamsize>::max(), '\n');
         break;
     }
 
-    ofstream outFile(profileFile, ios::trunc); // Open file in truncate mode to overwrite
-    if (!outFile) {
-        cerr << "Error opening file for writing: " << profileFile << endl;
-        return;
+    {
+        lock_guard<mutex> guard(stateLock);
+        sex = newSex;
+        age = newAge;
+        height = newHeight;
+        weight = newWeight;
+        activity = newActivity;
+        ++version;
+    }
+    if (changeListener) {
+        changeListener();
+    } else {
+        saveToFile();
     }
-    
-    outFile << "Gender: " << gender << "\n";
-    outFile << "Age: " << age << "\n";
-    outFile << "Height: " << height << "\n";
-    outFile << "Weight: " << weight << "\n";
-    outFile << "Activity Level: " << activityLevel << "\n";
-    
-    outFile.close();
 
     cout << "Profile updated.\n";
 }
 
+void DietProfile::saveToFile() {
+    uint64_t seen;
+    string text;
+    {
+        lock_guard<mutex> guard(stateLock);
+        if (version == savedVersion) return;
+        seen = version;
+        text = formatProfile();
+    }
+    if (writeFileAtomically(profileFile, text)) {
+        lock_guard<mutex> guard(stateLock);
+        savedVersion = max(savedVersion, seen);
+    }
+}
+
+string DietProfile::formatProfile() const {
+    ostringstream out;
+    out << "Gender: " << sexName(sex) << "\n";
+    out << "Age: " << age << "\n";
+    out << "Height: " << height << "\n";
+    out << "Weight: " << weight << "\n";
+    out << "Activity Level: " << activityName(activity) << "\n";
+    return out.str();
+}
+
 void DietProfile::viewProfile() {
-    ifstream inFile(profileFile);
-    if (!inFile || inFile.peek() == ifstream::traits_type::eof()) {
+    if (age <= 0) {
         cout << "No profile found. Redirecting to update profile...\n";
-        inFile.close();
         updateProfile();
         return;
     }
     
     cout << "\nCurrent Profile:\n";
-    string line;
-    while (getline(inFile, line)) {
-        cout << line << "\n";
-    }
-    
-    inFile.close();
+    cout << formatProfile();
 }
 
-void DietProfile::loadFromFile() {
+bool DietProfile::loadFromFile() {
+    YADA_TIMED("profile_load");
     ifstream inFile(profileFile);
     
     if (!inFile || inFile.peek() == ifstream::traits_type::eof()) {
-        inFile.close();
-        cout << "No profile found. Please create a new profile.\n";
-        updateProfile();
-        return;
+        return false;
     }
 
     string line;
+    long lineNumber = 0;
+    vector<ParseError> errors;
     while (getline(inFile, line)) {
+        ++lineNumber;
         istringstream iss(line);
         string key;
         if (getline(iss, key, ':')) {
@@ -248,21 +253,35 @@ void DietProfile::loadFromFile() {
             getline(iss, value);
             
             value.erase(0, value.find_first_not_of(" \t"));
+            value.erase(value.find_last_not_of(" \t\r") + 1);
 
+            bool parsed = true;
             if (key == "Gender") {
-                gender = value;
+                sex = parseSex(value);
             } else if (key == "Age") {
-                age = stoi(value);
+                parsed = parseNumber(value, age);
             } else if (key == "Height") {
-                height = stod(value);
+                parsed = parseNumber(value, height);
             } else if (key == "Weight") {
-                weight = stod(value);
+                parsed = parseNumber(value, weight);
             } else if (key == "Activity Level") {
-                activityLevel = value;
+                activity = parseActivity(value);
+            }
+            if (!parsed) {
+                errors.push_back({lineNumber, "bad " + key + " '" + value + "'"});
             }
         }
     }
 
+    // A profile that cannot be read is treated as missing, so the user is
+    // asked for a new one
+    if (!errors.empty()) {
+        reportErrors(profileFile, errors);
+        age = 0;
+        height = 0.0;
+        weight = 0.0;
+        return false;
+    }
     inFile.close();
-    cout << "Profile loaded successfully.\n";
+    return true;
 }
\ No newline at end of file
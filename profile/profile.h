@@ -2,23 +2,35 @@
 #define PROFILE_H
 
 #include <bits/stdc++.h>
+#include "targets.h"
 using namespace std;
 
 class DietProfile {
 public:
     void displayOptions();
-    int calculateTargetCalories() const;
-    void loadFromFile();
+    int calculateTargetCalories(Equation equation) const;
+    static Equation promptEquation();
+    bool loadFromFile();
+    // Writes the profile if it changed since the last save
+    void saveToFile();
+    void updateProfile();
+    // Called after every update; without one, updates are saved at once
+    void setChangeListener(function<void()> listener) { changeListener = move(listener); }
 
 private:
-    string gender;
+    Sex sex = Sex::Female;
     int age = 0;
     double height = 0.0;
     double weight = 0.0;
-    string activityLevel;
+    ActivityLevel activity = ActivityLevel::Sedentary;
     string profileFile = "data/profile.txt";
-    void updateProfile();
+    // Guards the fields against a save running on another thread
+    mutable mutex stateLock;
+    uint64_t version = 0;
+    uint64_t savedVersion = 0;
+    function<void()> changeListener;
     void viewProfile();
+    string formatProfile() const;
 };
 
 #endif
@@ -0,0 +1,79 @@
+#include "targets.h"
+
+static const char* const sexNames[] = {"female", "male"};
+static const char* const activityNames[] = {"sedentary", "light", "moderate", "active", "very active"};
+
+Sex parseSex(const string& text) {
+    return text == sexNames[1] ? Sex::Male : Sex::Female;
+}
+
+const char* sexName(Sex sex) {
+    return sexNames[static_cast<int>(sex)];
+}
+
+ActivityLevel parseActivity(const string& text) {
+    for (int i = 0; i < 5; ++i) {
+        if (text == activityNames[i]) {
+            return static_cast<ActivityLevel>(i);
+        }
+    }
+    return ActivityLevel::Sedentary;
+}
+
+const char* activityName(ActivityLevel activity) {
+    return activityNames[static_cast<int>(activity)];
+}
+
+void ProfileColumns::reserve(size_t count) {
+    sex.reserve(count);
+    activity.reserve(count);
+    equation.reserve(count);
+    age.reserve(count);
+    height.reserve(count);
+    weight.reserve(count);
+}
+
+void ProfileColumns::add(Sex sex, double age, double height, double weight, ActivityLevel activity, Equation equation) {
+    this->sex.push_back(static_cast<uint8_t>(sex));
+    this->activity.push_back(static_cast<uint8_t>(activity));
+    this->equation.push_back(static_cast<uint8_t>(equation));
+    this->age.push_back(age);
+    this->height.push_back(height);
+    this->weight.push_back(weight);
+}
+
+// All three equations are evaluated and blended with 0/1 weights instead of
+// branching, so a loop over this vectorizes. Only one term of each blend is
+// non-zero, so the result matches the branching formulas bit for bit.
+static inline int targetKernel(double male, double age, double height, double weight,
+                               uint8_t activity, uint8_t equation) {
+    double female = 1.0 - male;
+    double harrisBenedict = male * (88.362 + (13.397 * weight) + (4.799 * height) - (5.677 * age)) +
+                            female * (447.593 + (9.247 * weight) + (3.098 * height) - (4.330 * age));
+    double mifflinStJeor = (10 * weight) + (6.25 * height) - (5 * age) + (5 * male - 161 * female);
+    double katchMcArdle = 370 + (21.6 * (weight * 0.8));
+
+    double bmr = harrisBenedict * (equation == 0) + mifflinStJeor * (equation == 1) + katchMcArdle * (equation == 2);
+    double multiplier = 1.2 * (activity == 0) + 1.375 * (activity == 1) + 1.55 * (activity == 2) +
+                        1.725 * (activity == 3) + 1.9 * (activity == 4);
+    return static_cast<int>(bmr * multiplier);
+}
+
+void computeTargetCalories(const ProfileColumns& profiles, int* targets) {
+    const uint8_t* sex = profiles.sex.data();
+    const uint8_t* activity = profiles.activity.data();
+    const uint8_t* equation = profiles.equation.data();
+    const double* age = profiles.age.data();
+    const double* height = profiles.height.data();
+    const double* weight = profiles.weight.data();
+
+    size_t count = profiles.size();
+    for (size_t i = 0; i < count; ++i) {
+        targets[i] = targetKernel(sex[i], age[i], height[i], weight[i], activity[i], equation[i]);
+    }
+}
+
+int computeTargetCalories(Sex sex, double age, double height, double weight, ActivityLevel activity, Equation equation) {
+    return targetKernel(static_cast<uint8_t>(sex), age, height, weight,
+                        static_cast<uint8_t>(activity), static_cast<uint8_t>(equation));
+}
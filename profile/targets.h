@@ -0,0 +1,36 @@
+#ifndef TARGETS_H
+#define TARGETS_H
+
+#include <bits/stdc++.h>
+using namespace std;
+
+enum class Sex : uint8_t { Female, Male };
+enum class ActivityLevel : uint8_t { Sedentary, Light, Moderate, Active, VeryActive };
+enum class Equation : uint8_t { HarrisBenedict, MifflinStJeor, KatchMcArdle };
+
+// Unrecognised text falls back to Female and Sedentary, as the calculation
+// always has
+Sex parseSex(const string& text);
+const char* sexName(Sex sex);
+ActivityLevel parseActivity(const string& text);
+const char* activityName(ActivityLevel activity);
+
+// Profiles of a whole population, one column per attribute
+struct ProfileColumns {
+    vector<uint8_t> sex;
+    vector<uint8_t> activity;
+    vector<uint8_t> equation;
+    vector<double> age;
+    vector<double> height;
+    vector<double> weight;
+
+    size_t size() const { return sex.size(); }
+    void reserve(size_t count);
+    void add(Sex sex, double age, double height, double weight, ActivityLevel activity, Equation equation);
+};
+
+// Daily calorie target of every profile, written to targets[0, size())
+void computeTargetCalories(const ProfileColumns& profiles, int* targets);
+int computeTargetCalories(Sex sex, double age, double height, double weight, ActivityLevel activity, Equation equation);
+
+#endif // TARGETS_H
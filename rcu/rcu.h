@@ -0,0 +1,119 @@
+#ifndef RCU_H
+#define RCU_H
+
+#include <bits/stdc++.h>
+using namespace std;
+
+// Latest immutable version of a T. One writer builds each new version and
+// publishes it; any number of reader threads pin versions without locks and
+// keep using the one they pinned while newer ones come out. A version is
+// freed once the last reader holding it lets go.
+template <typename T>
+class Published {
+public:
+    // Null until the first version is published
+    shared_ptr<const T> pin() const { return atomic_load(&current); }
+    uint64_t version() const { return published.load(memory_order_acquire); }
+
+    void publish(shared_ptr<const T> next) {
+        atomic_store(&current, move(next));
+        published.fetch_add(1, memory_order_release);
+    }
+
+    // Per-thread handle. It re-pins only when a newer version is out, so
+    // steady-state reads write to no memory shared with other threads.
+    class Reader {
+    public:
+        explicit Reader(const Published& source) : source(source) {}
+        // Valid until the next call to get() on this reader
+        const T& get() {
+            uint64_t latest = source.version();
+            if (latest != seen || !pinned) {
+                pinned = source.pin();
+                seen = latest;
+            }
+            return *pinned;
+        }
+
+    private:
+        const Published& source;
+        shared_ptr<const T> pinned;
+        uint64_t seen = 0;
+    };
+
+private:
+    shared_ptr<const T> current;
+    atomic<uint64_t> published{0};
+};
+
+// Vector whose copies share storage: elements live in leaves of 256 under
+// branches of 256 leaves, and a change copies only the leaf and branch it
+// touches if another copy still shares them. Copying the vector itself
+// costs one pointer per 65536 elements, so a writer can keep a working copy
+// and publish a snapshot of it after every change.
+template <typename T>
+class PersistentVector {
+public:
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+
+    const T& operator[](size_t i) const {
+        return (*(*branches[i >> branchShift])[(i >> leafBits) & branchMask])[i & leafMask];
+    }
+
+    void push_back(T value) {
+        if ((count & (branchSpan - 1)) == 0) {
+            branches.push_back(make_shared<Branch>());
+        }
+        Branch& branch = writable(branches.back());
+        if ((count & leafMask) == 0) {
+            branch.push_back(make_shared<Leaf>());
+            branch.back()->reserve(leafMask + 1);
+        }
+        writable(branch.back()).push_back(move(value));
+        ++count;
+    }
+
+    void set(size_t i, T value) {
+        Branch& branch = writable(branches[i >> branchShift]);
+        writable(branch[(i >> leafBits) & branchMask])[i & leafMask] = move(value);
+    }
+
+    // Drops the elements from n on
+    void truncate(size_t n) {
+        if (n >= count) return;
+        branches.resize((n + branchSpan - 1) / branchSpan);
+        if (n % branchSpan != 0) {
+            Branch& branch = writable(branches.back());
+            branch.resize(((n % branchSpan) + leafMask) >> leafBits);
+            if ((n & leafMask) != 0) {
+                writable(branch.back()).resize(n & leafMask);
+            }
+        }
+        count = n;
+    }
+
+private:
+    static const size_t leafBits = 8;
+    static const size_t leafMask = (size_t(1) << leafBits) - 1;
+    static const size_t branchShift = 2 * leafBits;
+    static const size_t branchMask = leafMask;
+    static const size_t branchSpan = size_t(1) << branchShift;
+    using Leaf = vector<T>;
+    using Branch = vector<shared_ptr<Leaf>>;
+
+    // Only the writer's copy is ever changed, so a use count of 1 means no
+    // published version can see the node
+    template <typename Node>
+    static Node& writable(shared_ptr<Node>& node) {
+        if (node.use_count() > 1) {
+            node = make_shared<Node>(*node);
+        }
+        return *node;
+    }
+
+    vector<shared_ptr<Branch>> branches;
+    size_t count = 0;
+};
+
+#endif // RCU_H
@@ -0,0 +1,192 @@
+// Load generator for the command server. Opens several connections, keeps
+// up to --pipeline requests in flight on each, and reports throughput and
+// reply latency percentiles. Commands are taken in turn from --commands
+// (one per line) or from a built-in read-only mix.
+#include <bits/stdc++.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+using namespace std;
+
+struct Client {
+    int fd = -1;
+    string output;
+    size_t written = 0;
+    string input;
+    // Send times of the requests still waiting for a reply, oldest first
+    deque<chrono::steady_clock::time_point> inFlight;
+};
+
+static int connectTo(const string& address) {
+    int fd;
+    if (address.compare(0, 4, "tcp:") == 0) {
+        sockaddr_in remote = {};
+        remote.sin_family = AF_INET;
+        remote.sin_port = htons(stoi(address.substr(4)));
+        remote.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd >= 0 && connect(fd, reinterpret_cast<sockaddr*>(&remote), sizeof(remote)) != 0) {
+            ::close(fd);
+            return -1;
+        }
+        int on = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+    } else {
+        sockaddr_un remote = {};
+        remote.sun_family = AF_UNIX;
+        if (address.size() >= sizeof(remote.sun_path)) return -1;
+        address.copy(remote.sun_path, address.size());
+        fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd >= 0 && connect(fd, reinterpret_cast<sockaddr*>(&remote), sizeof(remote)) != 0) {
+            ::close(fd);
+            return -1;
+        }
+    }
+    return fd;
+}
+
+// Takes complete replies off the front of input; false when one is malformed
+static bool takeReplies(Client& client, vector<double>& latencies, long& errors) {
+    size_t start = 0;
+    while (true) {
+        size_t end = client.input.find('\n', start);
+        if (end == string::npos) break;
+        size_t next = end + 1;
+        if (client.input.compare(start, 3, "OK ") == 0) {
+            size_t length = stoul(client.input.substr(start + 3, end - start - 3));
+            if (client.input.size() - next < length) break;
+            next += length;
+        } else if (client.input.compare(start, 4, "ERR ") == 0) {
+            ++errors;
+        } else {
+            return false;
+        }
+        if (client.inFlight.empty()) return false;
+        auto now = chrono::steady_clock::now();
+        latencies.push_back(chrono::duration<double, micro>(now - client.inFlight.front()).count());
+        client.inFlight.pop_front();
+        start = next;
+    }
+    client.input.erase(0, start);
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    string address, commandFile;
+    long connections = 4, pipeline = 16, requests = 100000;
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (i + 1 >= argc) {
+            cerr << "Missing value for " << arg << "\n";
+            return 1;
+        }
+        string value = argv[++i];
+        if (arg == "--connect") address = value;
+        else if (arg == "--connections") connections = stol(value);
+        else if (arg == "--pipeline") pipeline = stol(value);
+        else if (arg == "--requests") requests = stol(value);
+        else if (arg == "--commands") commandFile = value;
+        else {
+            address.clear();
+            break;
+        }
+    }
+    if (address.empty() || connections < 1 || pipeline < 1 || requests < 1) {
+        cerr << "Usage: " << argv[0] << " --connect <socket-path|tcp:port> [--connections n] [--pipeline n]"
+             << " [--requests n] [--commands file]\n";
+        return 1;
+    }
+
+    vector<string> commands;
+    if (!commandFile.empty()) {
+        ifstream in(commandFile);
+        if (!in) {
+            cerr << "Error opening command file: " << commandFile << endl;
+            return 1;
+        }
+        string line;
+        while (getline(in, line)) {
+            if (!line.empty() && line[0] != '#') commands.push_back(line + "\n");
+        }
+    }
+    if (commands.empty()) {
+        commands = {"search any fruit\n", "summary\n", "target 2\n", "report 2025-01-01 2025-12-31\n"};
+    }
+
+    int epollFd = epoll_create1(EPOLL_CLOEXEC);
+    vector<Client> clients(connections);
+    for (size_t c = 0; c < clients.size(); ++c) {
+        clients[c].fd = connectTo(address);
+        if (clients[c].fd < 0) {
+            cerr << "Error connecting to " << address << ": " << strerror(errno) << endl;
+            return 1;
+        }
+        epoll_event event = {};
+        // Requests are written on every pass, so only replies need waking for
+        event.events = EPOLLIN;
+        event.data.u64 = c;
+        epoll_ctl(epollFd, EPOLL_CTL_ADD, clients[c].fd, &event);
+    }
+
+    vector<double> latencies;
+    latencies.reserve(requests);
+    long issued = 0, errors = 0;
+    auto start = chrono::steady_clock::now();
+    epoll_event events[64];
+    while (static_cast<long>(latencies.size()) < requests) {
+        // Top every connection up to the pipeline depth
+        for (auto& client : clients) {
+            while (issued < requests && static_cast<long>(client.inFlight.size()) < pipeline) {
+                client.output += commands[issued++ % commands.size()];
+                client.inFlight.push_back(chrono::steady_clock::now());
+            }
+            while (client.written < client.output.size()) {
+                ssize_t sent = send(client.fd, client.output.data() + client.written,
+                                    client.output.size() - client.written, MSG_NOSIGNAL | MSG_DONTWAIT);
+                if (sent <= 0) break;
+                client.written += sent;
+            }
+            if (client.written == client.output.size()) {
+                client.output.clear();
+                client.written = 0;
+            }
+        }
+
+        int count = epoll_wait(epollFd, events, 64, 1000);
+        for (int i = 0; i < count; ++i) {
+            Client& client = clients[events[i].data.u64];
+            char buffer[64 * 1024];
+            ssize_t received = recv(client.fd, buffer, sizeof(buffer), MSG_DONTWAIT);
+            if (received == 0 || (received < 0 && errno != EAGAIN && errno != EINTR)) {
+                cerr << "Server closed the connection" << endl;
+                return 1;
+            }
+            if (received > 0) {
+                client.input.append(buffer, received);
+                if (!takeReplies(client, latencies, errors)) {
+                    cerr << "Malformed reply from server" << endl;
+                    return 1;
+                }
+            }
+        }
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    sort(latencies.begin(), latencies.end());
+    auto percentile = [&](double p) { return latencies[min(latencies.size() - 1, size_t(p * latencies.size()))]; };
+    cout << fixed << setprecision(1)
+         << "requests " << requests << " errors " << errors << " connections " << connections
+         << " pipeline " << pipeline << "\n"
+         << "seconds " << setprecision(3) << seconds << " throughput " << setprecision(0)
+         << requests / max(seconds, 1e-9) << " req/s\n"
+         << "latency-us p50 " << setprecision(1) << percentile(0.5) << " p99 " << percentile(0.99)
+         << " p999 " << percentile(0.999) << " max " << latencies.back() << "\n";
+    for (auto& client : clients) {
+        ::close(client.fd);
+    }
+    ::close(epollFd);
+    return 0;
+}
@@ -0,0 +1,248 @@
+#include "server.h"
+#include "../metrics/metrics.h"
+#include "../io/lines.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+CommandServer::~CommandServer() {
+    for (auto& entry : connections) {
+        ::close(entry.first);
+    }
+    for (int fd : {listenFd, epollFd, signalFd}) {
+        if (fd >= 0) ::close(fd);
+    }
+    if (!socketPath.empty()) {
+        unlink(socketPath.c_str());
+    }
+}
+
+bool CommandServer::listen(const string& address) {
+    int port;
+    if (address.compare(0, 4, "tcp:") == 0 && parseNumber(string_view(address).substr(4), port)) {
+        listenFd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        int on = 1;
+        setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+        sockaddr_in local = {};
+        local.sin_family = AF_INET;
+        local.sin_port = htons(port);
+        local.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        if (listenFd < 0 || bind(listenFd, reinterpret_cast<sockaddr*>(&local), sizeof(local)) != 0) {
+            cerr << "Error listening on port " << port << ": " << strerror(errno) << endl;
+            return false;
+        }
+    } else {
+        sockaddr_un local = {};
+        local.sun_family = AF_UNIX;
+        if (address.size() >= sizeof(local.sun_path)) {
+            cerr << "Socket path too long: " << address << endl;
+            return false;
+        }
+        address.copy(local.sun_path, address.size());
+        listenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        // A socket file left behind by a server that did not shut down cleanly
+        unlink(address.c_str());
+        if (listenFd < 0 || bind(listenFd, reinterpret_cast<sockaddr*>(&local), sizeof(local)) != 0) {
+            cerr << "Error listening on " << address << ": " << strerror(errno) << endl;
+            return false;
+        }
+        socketPath = address;
+    }
+    if (::listen(listenFd, SOMAXCONN) != 0) {
+        cerr << "Error listening on " << address << ": " << strerror(errno) << endl;
+        return false;
+    }
+
+    // SIGINT and SIGTERM end run() through the loop instead of killing the
+    // process mid-write. Threads started after this inherit the mask.
+    sigset_t stopSignals;
+    sigemptyset(&stopSignals);
+    sigaddset(&stopSignals, SIGINT);
+    sigaddset(&stopSignals, SIGTERM);
+    sigprocmask(SIG_BLOCK, &stopSignals, nullptr);
+    signalFd = signalfd(-1, &stopSignals, SFD_NONBLOCK | SFD_CLOEXEC);
+
+    epollFd = epoll_create1(EPOLL_CLOEXEC);
+    for (int fd : {listenFd, signalFd}) {
+        epoll_event event = {};
+        event.events = EPOLLIN;
+        event.data.fd = fd;
+        epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event);
+    }
+    return true;
+}
+
+void CommandServer::run() {
+    epoll_event events[64];
+    bool stopping = false;
+    while (!stopping) {
+        int count = epoll_wait(epollFd, events, 64, -1);
+        if (count < 0) {
+            if (errno == EINTR) continue;
+            cerr << "Error waiting for clients: " << strerror(errno) << endl;
+            return;
+        }
+
+        for (int i = 0; i < count; ++i) {
+            int fd = events[i].data.fd;
+            if (fd == listenFd) {
+                acceptClients();
+                continue;
+            }
+            if (fd == signalFd) {
+                stopping = true;
+                continue;
+            }
+            auto it = connections.find(fd);
+            if (it == connections.end()) continue;
+
+            Connection& connection = it->second;
+            if (events[i].events & EPOLLERR) {
+                drop(connection);
+            } else if (events[i].events & (EPOLLIN | EPOLLHUP)) {
+                readFrom(connection);
+            } else {
+                serveRequests(connection);
+            }
+        }
+    }
+}
+
+void CommandServer::acceptClients() {
+    while (true) {
+        int fd = accept4(listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                cerr << "Error accepting client: " << strerror(errno) << endl;
+            }
+            if (errno == EINTR) continue;
+            return;
+        }
+        if (socketPath.empty()) {
+            // Replies are already gathered into one write per wakeup
+            int on = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+        }
+
+        Connection& connection = connections[fd];
+        connection.fd = fd;
+        connection.events = EPOLLIN;
+        epoll_event event = {};
+        event.events = connection.events;
+        event.data.fd = fd;
+        epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event);
+    }
+}
+
+void CommandServer::readFrom(Connection& connection) {
+    char buffer[64 * 1024];
+    ssize_t received = recv(connection.fd, buffer, sizeof(buffer), 0);
+    if (received > 0) {
+        connection.input.append(buffer, received);
+    } else if (received == 0) {
+        // The client sent everything; answer what is left, then hang up
+        connection.reading = false;
+        connection.closing = true;
+    } else if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+        drop(connection);
+        return;
+    }
+    serveRequests(connection);
+}
+
+// Answers every complete request while the client keeps up with the
+// replies, sends what the socket takes and re-arms epoll for the rest
+void CommandServer::serveRequests(Connection& connection) {
+    size_t start = 0;
+    while (connection.output.size() - connection.written < maxPendingOutput) {
+        size_t end = connection.input.find('\n', start);
+        if (end == string::npos) {
+            // A last request without a newline still counts once the client is done
+            if (!connection.closing || start == connection.input.size()) break;
+            end = connection.input.size();
+        }
+        string_view line(connection.input.data() + start, end - start);
+        if (!line.empty() && line.back() == '\r') {
+            line.remove_suffix(1);
+        }
+        start = min(end + 1, connection.input.size());
+
+        reply.str("");
+        bool ok;
+        {
+            YADA_TIMED("server_request");
+            ok = runner.execute(line, reply, error);
+        }
+        if (ok) {
+            string body = reply.str();
+            connection.output += "OK " + to_string(body.size()) + "\n";
+            connection.output += body;
+        } else {
+            connection.output += "ERR " + error + "\n";
+        }
+    }
+    connection.input.erase(0, start);
+    if (connection.input.size() > maxRequestBytes) {
+        connection.output += "ERR request too long\n";
+        connection.input.clear();
+        connection.reading = false;
+        connection.closing = true;
+    }
+
+    if (!writeTo(connection)) return;
+    bool done = connection.written == connection.output.size();
+    if (connection.closing && done && connection.input.empty()) {
+        drop(connection);
+        return;
+    }
+    watch(connection);
+}
+
+bool CommandServer::writeTo(Connection& connection) {
+    while (connection.written < connection.output.size()) {
+        ssize_t sent = send(connection.fd, connection.output.data() + connection.written,
+                            connection.output.size() - connection.written, MSG_NOSIGNAL);
+        if (sent < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+            drop(connection);
+            return false;
+        }
+        connection.written += sent;
+    }
+    if (connection.written == connection.output.size()) {
+        connection.output.clear();
+        connection.written = 0;
+    } else if (connection.written > connection.output.size() / 2) {
+        connection.output.erase(0, connection.written);
+        connection.written = 0;
+    }
+    return true;
+}
+
+void CommandServer::watch(Connection& connection) {
+    size_t pending = connection.output.size() - connection.written;
+    uint32_t events = 0;
+    // Stop reading from a client that does not collect its replies
+    if (connection.reading && pending < maxPendingOutput) events |= EPOLLIN;
+    if (pending > 0) events |= EPOLLOUT;
+    if (events == connection.events) return;
+
+    connection.events = events;
+    epoll_event event = {};
+    event.events = events;
+    event.data.fd = connection.fd;
+    epoll_ctl(epollFd, EPOLL_CTL_MOD, connection.fd, &event);
+}
+
+void CommandServer::drop(Connection& connection) {
+    int fd = connection.fd;
+    ::close(fd);
+    connections.erase(fd);
+}
@@ -0,0 +1,59 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+#include <bits/stdc++.h>
+#include "../batch/batch.h"
+using namespace std;
+
+// Serves the batch command language to many clients from one resident
+// process, on a single-threaded epoll loop. Each request is one command
+// line. Clients may pipeline requests; each connection's replies come back
+// in request order as
+//   OK <length>\n<length bytes of command output>
+//   ERR <message>\n
+class CommandServer {
+public:
+    explicit CommandServer(BatchRunner& runner) : runner(runner) {}
+    CommandServer(const CommandServer&) = delete;
+    CommandServer& operator=(const CommandServer&) = delete;
+    ~CommandServer();
+
+    // address is a Unix socket path, or tcp:<port> to listen on 127.0.0.1
+    bool listen(const string& address);
+    // Serves until SIGINT or SIGTERM arrives
+    void run();
+
+private:
+    struct Connection {
+        int fd;
+        string input;
+        string output;
+        size_t written = 0;
+        uint32_t events = 0;
+        bool reading = true;
+        bool closing = false;
+    };
+
+    // Stop reading from a client whose unread replies pass this, until it
+    // catches up
+    static const size_t maxPendingOutput = 1 << 20;
+    static const size_t maxRequestBytes = 1 << 16;
+
+    BatchRunner& runner;
+    int listenFd = -1;
+    int epollFd = -1;
+    int signalFd = -1;
+    string socketPath;
+    unordered_map<int, Connection> connections;
+    ostringstream reply;
+    string error;
+
+    void acceptClients();
+    void readFrom(Connection& connection);
+    void serveRequests(Connection& connection);
+    bool writeTo(Connection& connection);
+    void watch(Connection& connection);
+    void drop(Connection& connection);
+};
+
+#endif // SERVER_H